@@ -0,0 +1,204 @@
+#include "ArenaAllocator.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/mempolicy.h>
+#elif defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#endif
+
+namespace Arena
+{
+    // 小于该值的分配没有大页收益, 直接走普通堆
+    inline constexpr size_t kDirectAllocThreshold = size_t(256) << 10;
+
+#if defined(__linux__)
+    int NumaNodeCount()
+    {
+        static const int count = []()
+        {
+            int nodes = 0;
+            std::error_code ec;
+            for (const auto &entry : std::filesystem::directory_iterator("/sys/devices/system/node", ec))
+            {
+                auto name = entry.path().filename().string();
+                if (name.rfind("node", 0) == 0 && name.size() > 4 && std::isdigit(static_cast<unsigned char>(name[4])))
+                {
+                    ++nodes;
+                }
+            }
+            return std::max(nodes, 1);
+        }();
+        return count;
+    }
+
+    int CurrentNumaNode()
+    {
+        unsigned cpu = 0;
+        unsigned node = 0;
+        if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0)
+        {
+            return 0;
+        }
+        return static_cast<int>(node);
+    }
+
+    static void ApplyPlacement(void *ptr, size_t bytes, int numaNode)
+    {
+        const int nodeCount = NumaNodeCount();
+        if (nodeCount <= 1)
+        {
+            return;
+        }
+        unsigned long nodeMask = 0;
+        int mode = MPOL_DEFAULT;
+        if (numaNode >= 0)
+        {
+            mode = MPOL_BIND;
+            nodeMask = 1ul << numaNode;
+        }
+        else
+        {
+            switch (Settings::placementPolicy)
+            {
+            case PlacementPolicy::FirstTouch:
+                return;
+            case PlacementPolicy::Interleave:
+                mode = MPOL_INTERLEAVE;
+                nodeMask = (nodeCount >= 64) ? ~0ul : ((1ul << nodeCount) - 1);
+                break;
+            case PlacementPolicy::Bind:
+                mode = MPOL_BIND;
+                nodeMask = 1ul << std::clamp(Settings::bindNode, 0, nodeCount - 1);
+                break;
+            case PlacementPolicy::Preferred:
+                mode = MPOL_PREFERRED;
+                nodeMask = 1ul << std::clamp(Settings::bindNode, 0, nodeCount - 1);
+                break;
+            }
+        }
+        // 失败时保持默认策略, 不影响正确性
+        syscall(SYS_mbind, ptr, bytes, mode, &nodeMask, sizeof(nodeMask) * 8, 0);
+    }
+
+    void *AllocatePages(size_t bytes, int numaNode)
+    {
+        if (bytes < kDirectAllocThreshold)
+        {
+            return ::operator new(bytes, std::nothrow);
+        }
+        // 多申请一个大页用于对齐, 然后裁掉首尾
+        const size_t mapped = bytes + kHugePageSize;
+        void *raw = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED)
+        {
+            return nullptr;
+        }
+        uintptr_t begin = reinterpret_cast<uintptr_t>(raw);
+        uintptr_t aligned = (begin + kHugePageSize - 1) & ~(kHugePageSize - 1);
+        uintptr_t end = begin + mapped;
+        uintptr_t alignedEnd = aligned + ((bytes + 4095) & ~size_t(4095));
+        if (aligned > begin)
+        {
+            munmap(raw, aligned - begin);
+        }
+        if (end > alignedEnd)
+        {
+            munmap(reinterpret_cast<void *>(alignedEnd), end - alignedEnd);
+        }
+        void *ptr = reinterpret_cast<void *>(aligned);
+        if (Settings::useHugePages)
+        {
+            madvise(ptr, alignedEnd - aligned, MADV_HUGEPAGE);
+        }
+        ApplyPlacement(ptr, alignedEnd - aligned, numaNode); // 必须在首次写入之前
+        return ptr;
+    }
+
+    void FreePages(void *ptr, size_t bytes)
+    {
+        if (bytes < kDirectAllocThreshold)
+        {
+            ::operator delete(ptr);
+            return;
+        }
+        munmap(ptr, (bytes + 4095) & ~size_t(4095));
+    }
+
+#elif defined(_WIN32)
+    int NumaNodeCount()
+    {
+        ULONG highest = 0;
+        if (!GetNumaHighestNodeNumber(&highest))
+        {
+            return 1;
+        }
+        return static_cast<int>(highest) + 1;
+    }
+
+    int CurrentNumaNode()
+    {
+        PROCESSOR_NUMBER processor;
+        GetCurrentProcessorNumberEx(&processor);
+        USHORT node = 0;
+        if (!GetNumaProcessorNodeEx(&processor, &node))
+        {
+            return 0;
+        }
+        return static_cast<int>(node);
+    }
+
+    // Windows 大页需要 SeLockMemoryPrivilege, 这里只处理节点放置; Interleave 退化为系统默认
+    void *AllocatePages(size_t bytes, int numaNode)
+    {
+        if (bytes < kDirectAllocThreshold)
+        {
+            return ::operator new(bytes, std::nothrow);
+        }
+        if (numaNode < 0 && (Settings::placementPolicy == PlacementPolicy::Bind || Settings::placementPolicy == PlacementPolicy::Preferred))
+        {
+            numaNode = std::clamp(Settings::bindNode, 0, NumaNodeCount() - 1);
+        }
+        if (numaNode >= 0 && NumaNodeCount() > 1)
+        {
+            return VirtualAllocExNuma(GetCurrentProcess(), nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, static_cast<DWORD>(numaNode));
+        }
+        return VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    }
+
+    void FreePages(void *ptr, size_t bytes)
+    {
+        if (bytes < kDirectAllocThreshold)
+        {
+            ::operator delete(ptr);
+            return;
+        }
+        VirtualFree(ptr, 0, MEM_RELEASE);
+    }
+
+#else
+    int NumaNodeCount() { return 1; }
+    int CurrentNumaNode() { return 0; }
+
+    void *AllocatePages(size_t bytes, int)
+    {
+        return ::operator new(bytes, std::nothrow);
+    }
+
+    void FreePages(void *ptr, size_t)
+    {
+        ::operator delete(ptr);
+    }
+#endif
+}
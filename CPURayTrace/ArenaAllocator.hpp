@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+#include "MemoryRegistry.hpp"
+
+// 场景存储页面分配器
+// 大块页面(数MB)直接向系统申请: 对齐到2MB并 madvise(MADV_HUGEPAGE) 以使用透明大页, 减少TLB缺失;
+// 在多NUMA节点机器上按策略设置页面放置, 避免全部页面被加载线程首次触碰后落在同一节点.
+namespace Arena
+{
+    enum class PlacementPolicy
+    {
+        FirstTouch, // 系统默认: 首次写入的线程所在节点
+        Interleave, // 在所有节点间交错分配
+        Bind,       // 绑定到 Settings::bindNode
+        Preferred   // 优先 Settings::bindNode, 内存不足时回退
+    };
+
+    struct Settings
+    {
+        inline static bool useHugePages = true;
+        inline static PlacementPolicy placementPolicy = PlacementPolicy::Interleave;
+        inline static int bindNode = 0;
+        inline static bool replicateTopLevels = false; // 每个NUMA节点复制一份BVH顶层节点页面
+        inline static int replicatedDepth = 12;        // 复制的BVH层数
+    };
+
+    inline constexpr size_t kHugePageSize = size_t(2) << 20;
+
+    int NumaNodeCount();
+    int CurrentNumaNode(); // 调用线程当前所在NUMA节点, 不可用时返回0
+
+    /// @brief 按 Settings 申请页面内存
+    /// @param numaNode >=0 时忽略放置策略, 强制绑定到该节点(用于节点副本)
+    void *AllocatePages(size_t bytes, int numaNode = -1);
+    void FreePages(void *ptr, size_t bytes);
+
+    // 供 std::allocate_shared 使用的分配器, 分配的字节计入 category 的 reserved
+    template <typename T>
+    struct Allocator
+    {
+        using value_type = T;
+        int numaNode = -1;
+        MemoryRegistry::Category category = MemoryRegistry::Category::Count;
+
+        Allocator() = default;
+        explicit Allocator(MemoryRegistry::Category _category, int _numaNode = -1) : numaNode(_numaNode), category(_category) {}
+        template <typename U>
+        Allocator(const Allocator<U> &other) : numaNode(other.numaNode), category(other.category) {}
+
+        T *allocate(size_t n)
+        {
+            void *ptr = AllocatePages(n * sizeof(T), numaNode);
+            if (!ptr)
+            {
+                throw std::bad_alloc();
+            }
+            if (category != MemoryRegistry::Category::Count)
+            {
+                MemoryRegistry::AddReserved(category, static_cast<int64_t>(n * sizeof(T)));
+            }
+            return static_cast<T *>(ptr);
+        }
+        void deallocate(T *ptr, size_t n)
+        {
+            FreePages(ptr, n * sizeof(T));
+            if (category != MemoryRegistry::Category::Count)
+            {
+                MemoryRegistry::AddReserved(category, -static_cast<int64_t>(n * sizeof(T)));
+            }
+        }
+
+        // 任意节点分配的内存都可由 FreePages 释放, 因此所有实例可互换
+        template <typename U>
+        bool operator==(const Allocator<U> &) const { return true; }
+        template <typename U>
+        bool operator!=(const Allocator<U> &) const { return false; }
+    };
+}
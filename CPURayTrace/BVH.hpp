@@ -102,7 +102,34 @@ public:
         copy(copy, root, other.root);
     }
 
+    inline BVH(BVH &&other) noexcept : root(other.root)
+    {
+        other.root = nullptr;
+    }
+
+    // 拷贝赋值 叶子节点与源BVH共享物体
+    inline BVH &operator=(const BVH &other)
+    {
+        if (this != &other)
+        {
+            BVH copy(other);
+            std::swap(root, copy.root);
+        }
+        return *this;
+    }
+
+    inline BVH &operator=(BVH &&other) noexcept
+    {
+        std::swap(root, other.root);
+        return *this;
+    }
+
     inline ~BVH()
+    {
+        clear();
+    }
+
+    inline void clear()
     {
         // 递归删除节点
         auto deleteNode = [&](auto &&self, BVHNode *node) -> void
@@ -114,10 +141,21 @@ public:
             delete node;
         };
         deleteNode(deleteNode, root);
+        root = nullptr;
+    }
+
+    inline size_t nodeCount() const
+    {
+        auto count = [](auto &&self, const BVHNode *node) -> size_t
+        {
+            return node ? 1 + self(self, node->left) + self(self, node->right) : 0;
+        };
+        return count(count, root);
     }
 
     inline void build(std::vector<std::shared_ptr<Hittable>> &objects) // 构建的BVH叶子节点指向实际存储
     {
+        clear();
         root = BVH::BuildBVH(objects, 0, static_cast<int>(objects.size()));
     }
 
@@ -0,0 +1,249 @@
+#include "LightTree.hpp"
+#include "SimplifiedData.hpp"
+
+#include <glm/gtc/constants.hpp>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace SimplifiedData
+{
+    namespace
+    {
+        inline float SafeSqrt(float x)
+        {
+            return std::sqrt(std::max(x, 0.0f));
+        }
+
+        // cos(max(0, a - b)), 由 a, b 的正弦余弦给出
+        inline float CosSubClamped(float sinA, float cosA, float sinB, float cosB)
+        {
+            if (cosA > cosB)
+            {
+                return 1.0f;
+            }
+            return cosA * cosB + sinA * sinB;
+        }
+
+        // 把方向锥 (otherAxis, otherCos) 并入 (axis, cosTheta), 结果包含两者
+        void MergeCone(vec3 &axis, float &cosTheta, vec3 otherAxis, float otherCos)
+        {
+            if (cosTheta <= -1.0f)
+            {
+                return;
+            }
+            if (otherCos <= -1.0f)
+            {
+                cosTheta = -1.0f;
+                return;
+            }
+            if (glm::dot(axis, otherAxis) < 0.0f)
+            {
+                otherAxis = -otherAxis; // 双面发光, 法线可以翻转
+            }
+            const float pi = glm::pi<float>();
+            float thetaA = std::acos(std::clamp(cosTheta, -1.0f, 1.0f));
+            float thetaB = std::acos(std::clamp(otherCos, -1.0f, 1.0f));
+            float thetaD = std::acos(std::clamp(glm::dot(axis, otherAxis), -1.0f, 1.0f));
+            if (std::min(thetaD + thetaB, pi) <= thetaA)
+            {
+                return;
+            }
+            if (std::min(thetaD + thetaA, pi) <= thetaB)
+            {
+                axis = otherAxis;
+                cosTheta = otherCos;
+                return;
+            }
+            float thetaO = (thetaA + thetaD + thetaB) * 0.5f;
+            vec3 rotationAxis = glm::cross(axis, otherAxis);
+            if (thetaO >= pi || glm::dot(rotationAxis, rotationAxis) < 1e-12f)
+            {
+                cosTheta = -1.0f;
+                return;
+            }
+            // 绕 rotationAxis 把 axis 转向 otherAxis, 转角 thetaO - thetaA
+            rotationAxis = glm::normalize(rotationAxis);
+            float thetaR = thetaO - thetaA;
+            axis = glm::normalize(axis * std::cos(thetaR) + glm::cross(rotationAxis, axis) * std::sin(thetaR));
+            cosTheta = std::cos(thetaO);
+        }
+
+        // 节点对着色点贡献的保守估计: 功率 / 距离平方, 乘以光源侧与着色点侧余弦的上界
+        float Importance(const LightTree::Node &node, const vec3 &pos, const vec3 &normal)
+        {
+            if (node.power <= 0.0f)
+            {
+                return 0.0f;
+            }
+            vec3 center = (node.pMin + node.pMax) * 0.5f;
+            vec3 offset = pos - center;
+            float dist2 = glm::dot(offset, offset);
+            float radius2 = glm::dot(node.pMax - center, node.pMax - center);
+            vec3 wi = dist2 > 0.0f ? offset / std::sqrt(dist2) : normal; // 光源指向着色点
+
+            // 包围球在着色点所张的半角, 着色点在球内时为任意方向
+            float cosThetaB = -1.0f;
+            float sinThetaB = 0.0f;
+            if (dist2 > radius2)
+            {
+                float sin2ThetaB = radius2 / dist2;
+                cosThetaB = SafeSqrt(1.0f - sin2ThetaB);
+                sinThetaB = std::sqrt(sin2ThetaB);
+            }
+
+            // 光源侧: 方向锥与 wi 的最小夹角, 双面取绝对值
+            float cosThetaW = std::abs(glm::dot(node.axis, wi));
+            float cosThetaX = CosSubClamped(SafeSqrt(1.0f - cosThetaW * cosThetaW), cosThetaW, SafeSqrt(1.0f - node.cosTheta * node.cosTheta), node.cosTheta);
+            float cosThetaP = CosSubClamped(SafeSqrt(1.0f - cosThetaX * cosThetaX), cosThetaX, sinThetaB, cosThetaB);
+            if (cosThetaP <= 0.0f)
+            {
+                return 0.0f; // 超出发光的半球
+            }
+            // 着色点侧: 只有法线一侧的光源有贡献
+            float cosThetaI = -glm::dot(normal, wi);
+            float cosThetaPI = CosSubClamped(SafeSqrt(1.0f - cosThetaI * cosThetaI), cosThetaI, sinThetaB, cosThetaB);
+            if (cosThetaPI <= 0.0f)
+            {
+                return 0.0f;
+            }
+            // 距离下限避免着色点贴近光源时重要性发散
+            return node.power * cosThetaP * cosThetaPI / std::max(dist2, std::sqrt(radius2));
+        }
+    }
+
+    void LightTree::build(const TriangleStorage &triangleStorage, const EmitterList &emitters)
+    {
+        nodes.clear();
+        trails.clear();
+        std::vector<Node> leaves;
+        leaves.reserve(emitters.triangles.size());
+        for (uint32_t triangleIndex : emitters.triangles)
+        {
+            const Triangle &tri = triangleStorage.triangles[triangleIndex];
+            Node leaf;
+            leaf.pMin = glm::min(glm::min(tri.positions[0], tri.positions[1]), tri.positions[2]);
+            leaf.pMax = glm::max(glm::max(tri.positions[0], tri.positions[1]), tri.positions[2]);
+            vec3 normal = glm::cross(tri.positions[1] - tri.positions[0], tri.positions[2] - tri.positions[0]);
+            float length = glm::length(normal);
+            leaf.axis = length > 0.0f ? normal / length : vec3(0.0f, 1.0f, 0.0f);
+            leaf.power = (0.2126f * tri.emission.r + 0.7152f * tri.emission.g + 0.0722f * tri.emission.b) * 0.5f * length;
+            leaf.index = triangleIndex;
+            leaf.leaf = true;
+            leaves.push_back(leaf);
+        }
+        if (leaves.empty())
+        {
+            return;
+        }
+        nodes.reserve(leaves.size() * 2 - 1);
+        buildRecursive(leaves, 0, leaves.size(), 0, 0);
+    }
+
+    uint32_t LightTree::buildRecursive(std::vector<Node> &leaves, size_t start, size_t end, uint32_t depth, uint64_t trail)
+    {
+        if (end - start == 1)
+        {
+            nodes.push_back(leaves[start]);
+            trails[leaves[start].index] = trail;
+            return static_cast<uint32_t>(nodes.size() - 1);
+        }
+        // 按质心包围盒最长轴的中位数划分, 树高约 log2(n)
+        vec3 centroidMin(FLT_MAX);
+        vec3 centroidMax(-FLT_MAX);
+        for (size_t i = start; i < end; ++i)
+        {
+            vec3 centroid = (leaves[i].pMin + leaves[i].pMax) * 0.5f;
+            centroidMin = glm::min(centroidMin, centroid);
+            centroidMax = glm::max(centroidMax, centroid);
+        }
+        vec3 extent = centroidMax - centroidMin;
+        int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+        size_t mid = (start + end) / 2;
+        std::nth_element(leaves.begin() + start, leaves.begin() + mid, leaves.begin() + end, [axis](const Node &a, const Node &b)
+                         { return a.pMin[axis] + a.pMax[axis] < b.pMin[axis] + b.pMax[axis]; });
+
+        uint32_t index = static_cast<uint32_t>(nodes.size());
+        nodes.emplace_back();
+        buildRecursive(leaves, start, mid, depth + 1, trail);
+        uint32_t right = buildRecursive(leaves, mid, end, depth + 1, trail | (uint64_t(1) << depth));
+
+        const Node &leftNode = nodes[index + 1];
+        const Node &rightNode = nodes[right];
+        Node node;
+        node.pMin = glm::min(leftNode.pMin, rightNode.pMin);
+        node.pMax = glm::max(leftNode.pMax, rightNode.pMax);
+        node.axis = leftNode.axis;
+        node.cosTheta = leftNode.cosTheta;
+        MergeCone(node.axis, node.cosTheta, rightNode.axis, rightNode.cosTheta);
+        node.power = leftNode.power + rightNode.power;
+        node.index = right;
+        nodes[index] = node;
+        return index;
+    }
+
+    bool LightTree::sample(const vec3 &pos, const vec3 &normal, float u, uint32_t &triangleIndex, float &pmf) const
+    {
+        if (nodes.empty())
+        {
+            return false;
+        }
+        uint32_t index = 0;
+        pmf = 1.0f;
+        while (!nodes[index].leaf)
+        {
+            float leftImportance = Importance(nodes[index + 1], pos, normal);
+            float rightImportance = Importance(nodes[nodes[index].index], pos, normal);
+            if (leftImportance + rightImportance <= 0.0f)
+            {
+                return false;
+            }
+            // 选中后把 u 重新映射到 [0,1), 一个随机数走完整条路径
+            float pLeft = leftImportance / (leftImportance + rightImportance);
+            if (u < pLeft)
+            {
+                u = std::min(u / pLeft, 0x1.fffffep-1f);
+                pmf *= pLeft;
+                index = index + 1;
+            }
+            else
+            {
+                u = std::min((u - pLeft) / (1.0f - pLeft), 0x1.fffffep-1f);
+                pmf *= 1.0f - pLeft;
+                index = nodes[index].index;
+            }
+        }
+        if (Importance(nodes[index], pos, normal) <= 0.0f)
+        {
+            return false;
+        }
+        triangleIndex = nodes[index].index;
+        return true;
+    }
+
+    float LightTree::pmf(const vec3 &pos, const vec3 &normal, uint32_t triangleIndex) const
+    {
+        auto it = trails.find(triangleIndex);
+        if (it == trails.end())
+        {
+            return 0.0f;
+        }
+        uint64_t trail = it->second;
+        uint32_t index = 0;
+        float pmf = 1.0f;
+        while (!nodes[index].leaf)
+        {
+            float leftImportance = Importance(nodes[index + 1], pos, normal);
+            float rightImportance = Importance(nodes[nodes[index].index], pos, normal);
+            if (leftImportance + rightImportance <= 0.0f)
+            {
+                return 0.0f;
+            }
+            bool right = (trail & 1) != 0;
+            trail >>= 1;
+            pmf *= (right ? rightImportance : leftImportance) / (leftImportance + rightImportance);
+            index = right ? nodes[index].index : index + 1;
+        }
+        return Importance(nodes[index], pos, normal) > 0.0f ? pmf : 0.0f;
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "Utils.hpp"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace SimplifiedData
+{
+    class TriangleStorage;
+    class EmitterList;
+
+    // 发光三角形的层次结构(light BVH), 发光三角形成百上千时按着色点处的估计贡献选择光源
+    // 每个节点保存包围盒, 总功率与法线方向锥; 由根向下按两个子节点的重要性随机选择, 代价 O(log n)
+    // 发光三角形是双面的, 方向锥只约束法线所在的直线, 合并时可以翻转法线
+    class LightTree
+    {
+    public:
+        struct Node
+        {
+            vec3 pMin = vec3(0.0f);
+            vec3 pMax = vec3(0.0f);
+            vec3 axis = vec3(0.0f, 1.0f, 0.0f); // 法线方向锥的轴
+            float cosTheta = 1.0f;              // 方向锥半角的余弦, -1 表示任意方向
+            float power = 0.0f;                 // 亮度 * 面积 之和
+            uint32_t index = uint32_t(-1);      // 叶: 三角形序号; 内部: 右子节点序号, 左子节点紧随其后
+            bool leaf = false;
+        };
+
+        std::vector<Node> nodes;
+        // 三角形序号 -> 由根到叶的路径, 第 d 位为 1 表示第 d 层走右子节点; 用于 MIS 时计算选择概率
+        std::unordered_map<uint32_t, uint64_t> trails;
+
+        void build(const TriangleStorage &triangleStorage, const EmitterList &emitters);
+        inline bool empty() const { return nodes.empty(); }
+
+        // 在着色点 (pos, normal) 处按重要性选择一个发光三角形, u ∈ [0,1)
+        // 返回 false 表示所有光源的估计贡献都为 0
+        bool sample(const vec3 &pos, const vec3 &normal, float u, uint32_t &triangleIndex, float &pmf) const;
+        // sample 在同一着色点选中 triangleIndex 的概率
+        float pmf(const vec3 &pos, const vec3 &normal, uint32_t triangleIndex) const;
+
+    private:
+        uint32_t buildRecursive(std::vector<Node> &leaves, size_t start, size_t end, uint32_t depth, uint64_t trail);
+    };
+}
@@ -3,6 +3,8 @@
 #include "Trace.hpp"
 #include "Random.hpp"
 #include "Scene.hpp"
+#include "EnvironmentMap.hpp"
+#include "Microfacet.hpp"
 class Lambertian : public Material
 {
 public:
@@ -23,7 +25,15 @@ public:
         auto bounceRay = Ray(
             pos + bias,
             rndDir);
-        color4 irradiance = albedo * Trace::CastRay(bounceRay, traceDepth + 1, scene);
+        // 天空显式采样, 与下面的 BSDF 采样按 MIS 合并
+        color4 direct(0.0f);
+        const EnvironmentMap *environment = EnvironmentMap::Current();
+        if (environment && EnvironmentMap::importanceSampling.load(std::memory_order_relaxed))
+        {
+            direct = color4(Trace::SampleEnvironment(*environment, pos + bias, ShadingBsdf::Diffuse(normal, vec3(albedo)), scene), 0.0f);
+        }
+        float bsdfPdf = std::max(glm::dot(normal, rndDir), 0.0f) * glm::one_over_pi<float>();
+        color4 irradiance = albedo * Trace::CastRay(bounceRay, traceDepth + 1, scene, bsdfPdf) + direct;
 
         return irradiance;
     }
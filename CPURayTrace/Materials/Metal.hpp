@@ -2,6 +2,9 @@
 #include "Materials.hpp"
 #include "Trace.hpp"
 #include "Random.hpp"
+#include "EnvironmentMap.hpp"
+#include "Microfacet.hpp"
+// GGX 微表面金属, albedo 为法向入射的反射率 F0, gross 为粗糙度(0 为理想镜面)
 class Metal : public Material
 {
 
@@ -19,13 +22,25 @@ public:
         auto &dir = hitInfos.dir;
 
         vec3 bias = normal * 1e-4f; // 防止自相交
-        vec3 rndDir = Random::GenerateCosineSemiSphereVector(normal);
-        vec3 reflectDir = dir - normal * dot(dir, normal) * 2.f;
-        vec3 rayDir = normalize(rndDir * gross + reflectDir * (1 - gross));
+        ShadingBsdf bsdf = ShadingBsdf::Glossy(normal, -normalize(dir), vec3(albedo), gross);
+        // 粗糙金属也显式采样天空, 与 BSDF 采样按 MIS 合并; 镜面只靠 BSDF 采样
+        color4 direct(0.0f);
+        const EnvironmentMap *environment = EnvironmentMap::Current();
+        if (environment && EnvironmentMap::importanceSampling.load(std::memory_order_relaxed) && !bsdf.isSpecular())
+        {
+            direct = color4(Trace::SampleEnvironment(*environment, pos + bias, bsdf, scene), 0.0f);
+        }
+        vec3 rayDir;
+        float bsdfPdf;
+        vec3 weight = bsdf.sample(rayDir, bsdfPdf);
+        if (weight == vec3(0.0f))
+        {
+            return direct; // 反射方向落到表面以下
+        }
         auto bounceRay = Ray(
             pos + bias,
             rayDir);
-        color4 irradiance = albedo * Trace::CastRay(bounceRay, traceDepth + 1, scene);
+        color4 irradiance = color4(weight, albedo.a) * Trace::CastRay(bounceRay, traceDepth + 1, scene, bsdfPdf) + direct;
 
         return irradiance;
     }
@@ -0,0 +1,156 @@
+#pragma once
+#include "Utils.hpp"
+#include "Random.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// GGX 微表面反射, Smith 高度相关遮蔽, Schlick 菲涅尔(F0 为金属颜色)
+// 采样只取可见法线分布(VNDF, Heitz 2018), 采样权重 f*cos/pdf = F * G2 / G1(wo), 不会像采样 D 那样在掠射角爆出高权重
+// 方向都在世界空间, wo 指向观察方向, wi 指向光源方向
+namespace Microfacet
+{
+    // 粗糙度到 GGX α, 过小的 α 视为理想镜面
+    inline float Alpha(float roughness) { return std::max(roughness * roughness, 1e-4f); }
+    inline bool IsSpecular(float alpha) { return alpha < 1e-3f; }
+
+    // 以法线为 z 轴的正交基 (Duff et al. 2017)
+    struct Frame
+    {
+        vec3 t, b, n;
+        explicit Frame(const vec3 &normal) : n(normal)
+        {
+            float sign = std::copysign(1.0f, n.z);
+            float a = -1.0f / (sign + n.z);
+            float c = n.x * n.y * a;
+            t = vec3(1.0f + sign * n.x * n.x * a, sign * c, -sign * n.x);
+            b = vec3(c, sign + n.y * n.y * a, -n.y);
+        }
+        inline vec3 toLocal(const vec3 &v) const { return vec3(glm::dot(v, t), glm::dot(v, b), glm::dot(v, n)); }
+        inline vec3 toWorld(const vec3 &v) const { return t * v.x + b * v.y + n * v.z; }
+    };
+
+    inline float D(float cosH, float alpha)
+    {
+        float a2 = alpha * alpha;
+        float d = cosH * cosH * (a2 - 1.0f) + 1.0f;
+        return a2 / (glm::pi<float>() * d * d);
+    }
+    inline float Lambda(float cosTheta, float alpha)
+    {
+        float cos2 = cosTheta * cosTheta;
+        float tan2 = std::max(1.0f - cos2, 0.0f) / std::max(cos2, 1e-8f);
+        return 0.5f * (std::sqrt(1.0f + alpha * alpha * tan2) - 1.0f);
+    }
+    inline float G1(float cosTheta, float alpha) { return 1.0f / (1.0f + Lambda(cosTheta, alpha)); }
+    inline float G2(float cosO, float cosI, float alpha) { return 1.0f / (1.0f + Lambda(cosO, alpha) + Lambda(cosI, alpha)); }
+    inline vec3 Fresnel(const vec3 &f0, float cosTheta)
+    {
+        float m = std::clamp(1.0f - cosTheta, 0.0f, 1.0f);
+        float m2 = m * m;
+        return f0 + (vec3(1.0f) - f0) * (m2 * m2 * m);
+    }
+
+    // 局部坐标下按 wo 可见的法线分布采样半程向量
+    inline vec3 SampleVNDF(const vec3 &wo, float alpha, float u1, float u2)
+    {
+        vec3 vh = glm::normalize(vec3(alpha * wo.x, alpha * wo.y, wo.z));
+        float lengthSquared = vh.x * vh.x + vh.y * vh.y;
+        vec3 t1 = lengthSquared > 0.0f ? vec3(-vh.y, vh.x, 0.0f) / std::sqrt(lengthSquared) : vec3(1.0f, 0.0f, 0.0f);
+        vec3 t2 = glm::cross(vh, t1);
+        float r = std::sqrt(u1);
+        float phi = 2.0f * glm::pi<float>() * u2;
+        float p1 = r * std::cos(phi);
+        float p2 = r * std::sin(phi);
+        float s = 0.5f * (1.0f + vh.z);
+        p2 = (1.0f - s) * std::sqrt(std::max(1.0f - p1 * p1, 0.0f)) + s * p2;
+        vec3 nh = t1 * p1 + t2 * p2 + vh * std::sqrt(std::max(1.0f - p1 * p1 - p2 * p2, 0.0f));
+        return glm::normalize(vec3(alpha * nh.x, alpha * nh.y, std::max(nh.z, 1e-6f)));
+    }
+}
+
+// 着色点的 BSDF, 供 BSDF 采样与光源/天空采样共用
+// evaluate 返回 f * cos 与 BSDF 采样到该方向的概率密度; 镜面没有可求值的方向, 光源采样应跳过
+struct ShadingBsdf
+{
+    enum class Type
+    {
+        Diffuse,
+        Glossy
+    };
+    Type type = Type::Diffuse;
+    vec3 normal = vec3(0.0f, 1.0f, 0.0f);
+    vec3 wo = vec3(0.0f, 1.0f, 0.0f);
+    vec3 albedo = vec3(0.0f);
+    float alpha = 1.0f;
+
+    inline static ShadingBsdf Diffuse(const vec3 &normal, const vec3 &albedo)
+    {
+        return ShadingBsdf{Type::Diffuse, normal, normal, albedo, 1.0f};
+    }
+    inline static ShadingBsdf Glossy(const vec3 &normal, const vec3 &wo, const vec3 &albedo, float roughness)
+    {
+        return ShadingBsdf{Type::Glossy, normal, wo, albedo, Microfacet::Alpha(roughness)};
+    }
+
+    inline bool isSpecular() const { return type == Type::Glossy && Microfacet::IsSpecular(alpha); }
+
+    inline vec3 evaluate(const vec3 &wi, float &pdf) const
+    {
+        pdf = 0.0f;
+        float cosI = glm::dot(normal, wi);
+        if (cosI <= 0.0f)
+        {
+            return vec3(0.0f);
+        }
+        if (type == Type::Diffuse)
+        {
+            pdf = cosI * glm::one_over_pi<float>();
+            return albedo * pdf;
+        }
+        if (isSpecular())
+        {
+            return vec3(0.0f);
+        }
+        float cosO = std::max(glm::dot(normal, wo), 1e-4f);
+        vec3 h = glm::normalize(wo + wi);
+        float cosH = std::max(glm::dot(normal, h), 0.0f);
+        float d = Microfacet::D(cosH, alpha);
+        pdf = Microfacet::G1(cosO, alpha) * d / (4.0f * cosO);
+        return Microfacet::Fresnel(albedo, std::max(glm::dot(wo, h), 0.0f)) * (d * Microfacet::G2(cosO, cosI, alpha) / (4.0f * cosO));
+    }
+
+    // 采样入射方向, 返回 f * cos / pdf; 镜面时 pdf 为 0. 返回 0 表示路径应终止
+    inline vec3 sample(vec3 &wi, float &pdf) const
+    {
+        if (type == Type::Diffuse)
+        {
+            wi = Random::GenerateCosineSemiSphereVector(normal);
+            pdf = std::max(glm::dot(normal, wi), 0.0f) * glm::one_over_pi<float>();
+            return albedo;
+        }
+        float cosO = glm::dot(normal, wo);
+        if (isSpecular())
+        {
+            wi = glm::reflect(-wo, normal);
+            pdf = 0.0f;
+            return Microfacet::Fresnel(albedo, std::max(cosO, 0.0f));
+        }
+        Microfacet::Frame frame(normal);
+        vec3 localWo = frame.toLocal(wo);
+        localWo.z = std::max(localWo.z, 1e-4f); // 插值法线下观察方向可能略低于切平面
+        localWo = glm::normalize(localWo);
+        glm::vec2 u = Random::Sample2D();
+        vec3 h = frame.toWorld(Microfacet::SampleVNDF(localWo, alpha, u.x, u.y));
+        wi = glm::reflect(-wo, h);
+        float cosI = glm::dot(normal, wi);
+        if (cosI <= 0.0f)
+        {
+            pdf = 0.0f;
+            return vec3(0.0f);
+        }
+        cosO = localWo.z;
+        pdf = Microfacet::G1(cosO, alpha) * Microfacet::D(std::max(glm::dot(normal, h), 0.0f), alpha) / (4.0f * cosO);
+        return Microfacet::Fresnel(albedo, std::max(glm::dot(wo, h), 0.0f)) * (Microfacet::G2(cosO, cosI, alpha) / Microfacet::G1(cosO, alpha));
+    }
+};
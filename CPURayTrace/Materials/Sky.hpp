@@ -1,5 +1,6 @@
 #pragma once
 #include "Materials.hpp"
+#include "EnvironmentMap.hpp"
 
 class Sky : public Material
 {
@@ -7,11 +8,20 @@ public:
     ~Sky() {}
     Sky() = default;
     Sky(const Sky& other) = default;
-    color4 getIrradiance(const HitInfos &hitInfos, int traceDepth, const Scene &scene) const override
+    // 天空辐射亮度: 有 CPU 天空表时查表, 否则为渐变
+    inline static vec3 Radiance(const EnvironmentMap *environment, const vec3 &dir)
     {
-        vec3 unit_direction = normalize(hitInfos.dir);
+        vec3 unit_direction = normalize(dir);
+        if (environment)
+        {
+            return environment->lookup(unit_direction);
+        }
         auto a = 0.5f * (unit_direction.y + 1.0f);
-        return color4((1.0f - a) * vec3(1.0f, 1.0f, 1.0f) + a * vec3(0.5f, 0.7f, 1.0f), 1.0f) / 1.f;
+        return (1.0f - a) * vec3(1.0f, 1.0f, 1.0f) + a * vec3(0.5f, 0.7f, 1.0f);
+    }
+    color4 getIrradiance(const HitInfos &hitInfos, int traceDepth, const Scene &scene) const override
+    {
+        return color4(Radiance(EnvironmentMap::Current(), hitInfos.dir), 1.0f);
     }
     std::unique_ptr<Material> clone() const override
     {
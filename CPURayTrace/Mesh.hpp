@@ -5,6 +5,7 @@
 #include "Bounding.hpp"
 #include "BVH.hpp"
 #include "BVHUI.hpp"
+#include "MemoryRegistry.hpp"
 #include <optional>
 #include <vector>
 
@@ -89,19 +90,28 @@ public:
     ~Triangle() {}
 };
 
+// 网格共享数据: 三角形集合与内部BVH构建完成后不可变, 在Mesh的所有拷贝之间共享
+struct MeshData
+{
+    std::vector<std::shared_ptr<Triangle>> triangles;
+    BoundingBox boundingBox;
+    BVH insideBVH;
+    MemoryRegistry::Tracker memoryTracker{MemoryRegistry::Category::LegacyScene};
+};
+
 class Mesh : public Hittable
 {
 public:
     // Mesh = 顶点array + 索引array + 材质
     // 或者是 三角形array
-    std::vector<std::shared_ptr<Triangle>> triangles;
+    std::shared_ptr<const MeshData> data;
     std::unique_ptr<Material> pMaterial;
-    BoundingBox boundingBox;
-    BVH insideBVH;
 
     Mesh(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices, const Material& _material)
         : pMaterial(_material.clone())
     {
+        auto meshData = std::make_shared<MeshData>();
+        auto &triangles = meshData->triangles;
         triangles.reserve(indices.size() / 3);
         for (size_t i = 0; i < indices.size(); i += 3)
         {
@@ -110,6 +120,7 @@ public:
         }
         if (!triangles.empty())
         {
+            auto &boundingBox = meshData->boundingBox;
             boundingBox = triangles[0]->getBoundingBox();
             for (size_t i = 1; i < triangles.size(); i++)
             {
@@ -118,50 +129,36 @@ public:
             }
         }
 
-        std::vector<std::shared_ptr<Hittable>> hittablePtrs;
-        hittablePtrs.reserve(triangles.size());
-
-        for (const auto &triPtr : triangles)
-        {
-            std::shared_ptr<Hittable> hittablePtr = triPtr;
-
-            // 或者直接 push_back
-            hittablePtrs.push_back(triPtr);
-        }
+        std::vector<std::shared_ptr<Hittable>> hittablePtrs(triangles.begin(), triangles.end());
         // build BVH
-        insideBVH.build(hittablePtrs);
+        meshData->insideBVH.build(hittablePtrs);
+        size_t triangleBytes = triangles.size() * sizeof(Triangle);
+        size_t bvhBytes = meshData->insideBVH.nodeCount() * sizeof(BVHNode);
+        meshData->memoryTracker.set(
+            triangles.capacity() * sizeof(std::shared_ptr<Triangle>) + triangleBytes + bvhBytes,
+            triangles.size() * sizeof(std::shared_ptr<Triangle>) + triangleBytes + bvhBytes);
+        data = std::move(meshData);
     }
 
+    // 拷贝只共享网格数据, 不重建BVH
     Mesh(const Mesh &other)
+        : data(other.data),
+          pMaterial(other.pMaterial ? other.pMaterial->clone() : nullptr)
     {
-        triangles = other.triangles;
-        pMaterial = other.pMaterial ? other.pMaterial->clone() : nullptr;
-        boundingBox = other.boundingBox;
-
-        std::vector<std::shared_ptr<Hittable>> hittablePtrs;
-        hittablePtrs.reserve(triangles.size());
-
-        for (const auto &triPtr : triangles)
-        {
-            std::shared_ptr<Hittable> hittablePtr = triPtr;
-
-            // 或者直接 push_back
-            hittablePtrs.push_back(triPtr);
-        }
-        insideBVH.build(hittablePtrs);
     }
+    Mesh(Mesh &&other) noexcept = default;
 
     std::optional<HitInfos> intersect(const Ray &ray) override
     {
         if (BVHSettings::toggleBVHAccel)
 
         {
-            return std::make_optional(insideBVH.intersect(ray));
+            return std::make_optional(data->insideBVH.intersect(ray));
         }
         else
         {
             HitInfos closestHit;
-            for (auto &&tri : triangles)
+            for (auto &&tri : data->triangles)
             {
                 auto hitInfos = tri->intersect(ray);
                 if (hitInfos && hitInfos->t < closestHit.t)
@@ -181,8 +178,8 @@ public:
     }
     BoundingBox getBoundingBox() override
     {
-        return boundingBox;
+        return data->boundingBox;
     }
 
-    BVHNode *getInsideBVHRoot() override { return insideBVH.root; }
+    BVHNode *getInsideBVHRoot() override { return data->insideBVH.root; }
 };
\ No newline at end of file
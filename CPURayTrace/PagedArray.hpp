@@ -0,0 +1,102 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "ArenaAllocator.hpp"
+
+namespace SimplifiedData
+{
+    // 分页写时复制(COW)数组
+    // 页面由 shared_ptr 持有, 拷贝 PagedArray 只拷贝页表, 未修改的页面在各个拷贝之间共享.
+    // 写入前若页面仍被其他拷贝引用, 则先复制该页. 因此拷贝(快照)的代价正比于页数, 修改的代价正比于被修改的页数.
+    // 页面按需分配, 未写入过的页面不占内存. 读取未分配的页面是未定义行为, 调用方保证只读取已写入的索引.
+    // 页面内存来自 Arena 分配器(大页 + NUMA放置策略), 物理页面字节计入 category 的 reserved, 共享页面只计一次.
+    // [线程安全]: 读与读之间安全; 写入与拷贝必须由同一个写者串行执行(由外部锁保证)
+    template <typename T, uint32_t PageBits = 14>
+    class PagedArray
+    {
+    public:
+        static constexpr uint32_t kPageBits = PageBits;
+        static constexpr size_t kPageSize = size_t(1) << PageBits;
+        static constexpr size_t kPageMask = kPageSize - 1;
+
+        struct Page
+        {
+            std::array<T, kPageSize> items;
+        };
+
+        PagedArray() = default;
+        explicit PagedArray(size_t capacity, MemoryRegistry::Category _category = MemoryRegistry::Category::Count)
+            : pages((capacity + kPageSize - 1) >> PageBits),
+              category(_category)
+        {
+        }
+
+        inline size_t size() const { return pages.size() * kPageSize; }
+        inline size_t pageCount() const { return pages.size(); }
+
+        inline const T &operator[](size_t index) const
+        {
+            return pages[index >> PageBits]->items[index & kPageMask];
+        }
+
+        // 取得可写引用, 必要时分配或复制页面
+        inline T &writable(size_t index)
+        {
+            auto &page = pages[index >> PageBits];
+            if (!page)
+            {
+                page = std::allocate_shared<Page>(Arena::Allocator<Page>(category));
+            }
+            else if (page.use_count() > 1) // 页面被快照共享, 复制后再写
+            {
+                page = std::allocate_shared<Page>(Arena::Allocator<Page>(category), *page);
+            }
+            return page->items[index & kPageMask];
+        }
+
+        inline void set(size_t index, const T &value)
+        {
+            writable(index) = value;
+        }
+
+        // 将页面复制到指定NUMA节点上(用于节点本地副本), 其他拷贝仍持有原页面
+        inline void localizePage(size_t pageIndex, int numaNode)
+        {
+            auto &page = pages[pageIndex];
+            if (page)
+            {
+                page = std::allocate_shared<Page>(Arena::Allocator<Page>(category, numaNode), *page);
+            }
+        }
+
+        // 已分配页面数
+        inline size_t allocatedPageCount() const
+        {
+            size_t count = 0;
+            for (const auto &page : pages)
+            {
+                count += page ? 1 : 0;
+            }
+            return count;
+        }
+
+        // 与其他拷贝共享的页面数
+        inline size_t sharedPageCount() const
+        {
+            size_t count = 0;
+            for (const auto &page : pages)
+            {
+                count += (page && page.use_count() > 1) ? 1 : 0;
+            }
+            return count;
+        }
+
+    private:
+        std::vector<std::shared_ptr<Page>> pages;
+        MemoryRegistry::Category category = MemoryRegistry::Category::Count;
+    };
+}
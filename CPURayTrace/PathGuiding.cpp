@@ -0,0 +1,328 @@
+#include "PathGuiding.hpp"
+#include "ThreadPool.hpp"
+
+#include <glm/gtc/constants.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace PathGuiding
+{
+    namespace
+    {
+        constexpr float kOneMinusEpsilon = 0x1.fffffep-1f;
+
+        // 等面积圆柱映射: x 为 (cosθ + 1) / 2, y 为 φ / 2π, 单位正方形上的密度乘以 1 / 4π 即立体角密度
+        inline vec2 DirectionToCanonical(const vec3 &dir)
+        {
+            float cosTheta = std::clamp(dir.z, -1.0f, 1.0f);
+            float phi = std::atan2(dir.y, dir.x);
+            if (phi < 0.0f)
+            {
+                phi += glm::two_pi<float>();
+            }
+            return vec2(std::clamp((cosTheta + 1.0f) * 0.5f, 0.0f, kOneMinusEpsilon),
+                        std::clamp(phi * glm::one_over_two_pi<float>(), 0.0f, kOneMinusEpsilon));
+        }
+
+        inline vec3 CanonicalToDirection(const vec2 &p)
+        {
+            float cosTheta = 2.0f * p.x - 1.0f;
+            float sinTheta = std::sqrt(std::max(1.0f - cosTheta * cosTheta, 0.0f));
+            float phi = glm::two_pi<float>() * p.y;
+            return vec3(sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta);
+        }
+
+        inline float NodeTotal(const DTree::Node &node)
+        {
+            return node.sum[0] + node.sum[1] + node.sum[2] + node.sum[3];
+        }
+    }
+
+    float DTree::pdf(const vec3 &dir) const
+    {
+        vec2 p = DirectionToCanonical(dir);
+        float density = 1.0f;
+        uint32_t index = 0;
+        while (true)
+        {
+            const Node &node = nodes[index];
+            float total = NodeTotal(node);
+            if (total <= 0.0f)
+            {
+                return 0.0f;
+            }
+            int column = p.x >= 0.5f ? 1 : 0;
+            int row = p.y >= 0.5f ? 1 : 0;
+            int quadrant = row * 2 + column;
+            density *= 4.0f * node.sum[quadrant] / total;
+            if (node.child[quadrant] == 0)
+            {
+                break;
+            }
+            index = node.child[quadrant];
+            p = p * 2.0f - vec2(column, row);
+        }
+        return density * (0.25f * glm::one_over_pi<float>());
+    }
+
+    vec3 DTree::sample(vec2 u) const
+    {
+        vec2 origin(0.0f);
+        float size = 1.0f;
+        uint32_t index = 0;
+        while (true)
+        {
+            const Node &node = nodes[index];
+            float total = NodeTotal(node);
+            if (total <= 0.0f)
+            {
+                return CanonicalToDirection(origin + u * size);
+            }
+            // 先按两列的能量选列, 再在列内选行, 每次把所用的随机数重新映射到 [0,1)
+            // 舍入可能让 u 落到能量为 0 的一侧, 此时改选另一侧, 避免除以 0
+            float left = node.sum[0] + node.sum[2];
+            float right = total - left;
+            int column = u.x * total < left ? 0 : 1;
+            if (column == 1 && !(right > 0.0f))
+            {
+                column = 0;
+            }
+            else if (column == 0 && !(left > 0.0f))
+            {
+                column = 1;
+            }
+            float columnTotal = column == 0 ? left : right;
+            u.x = column == 0 ? u.x * total / left : (u.x * total - left) / right;
+            float bottom = node.sum[column];
+            float top = columnTotal - bottom;
+            int row = u.y * columnTotal < bottom ? 0 : 1;
+            if (row == 1 && !(top > 0.0f))
+            {
+                row = 0;
+            }
+            else if (row == 0 && !(bottom > 0.0f))
+            {
+                row = 1;
+            }
+            u.y = row == 0 ? u.y * columnTotal / bottom : (u.y * columnTotal - bottom) / top;
+            u = glm::clamp(u, vec2(0.0f), vec2(kOneMinusEpsilon));
+
+            int quadrant = row * 2 + column;
+            size *= 0.5f;
+            origin += vec2(column, row) * size;
+            if (node.child[quadrant] == 0)
+            {
+                return CanonicalToDirection(origin + u * size);
+            }
+            index = node.child[quadrant];
+        }
+    }
+
+    void DTree::record(std::atomic<float> *recorded, const vec3 &dir, float value) const
+    {
+        vec2 p = DirectionToCanonical(dir);
+        uint32_t index = 0;
+        while (true)
+        {
+            int column = p.x >= 0.5f ? 1 : 0;
+            int row = p.y >= 0.5f ? 1 : 0;
+            int quadrant = row * 2 + column;
+            recorded[index * 4 + quadrant].fetch_add(value, std::memory_order_relaxed);
+            uint32_t child = nodes[index].child[quadrant];
+            if (child == 0)
+            {
+                return;
+            }
+            index = child;
+            p = p * 2.0f - vec2(column, row);
+        }
+    }
+
+    DTree DTree::rebuild(const std::atomic<float> *recorded, float threshold, int maxDepth) const
+    {
+        float total = 0.0f;
+        for (int q = 0; q < 4; ++q)
+        {
+            total += recorded[q].load(std::memory_order_relaxed);
+        }
+        if (!(total > 0.0f))
+        {
+            return *this;
+        }
+        // 旧树中已是叶的象限没有更细的记录, 细分时把能量均分给四个子象限
+        struct Item
+        {
+            uint32_t newIndex;
+            uint32_t oldIndex;
+            bool hasOld;
+            float energy;
+            int depth;
+        };
+        DTree result;
+        std::vector<Item> stack{{0, 0, true, total, 1}};
+        while (!stack.empty())
+        {
+            Item item = stack.back();
+            stack.pop_back();
+            for (int q = 0; q < 4; ++q)
+            {
+                float energy = item.energy * 0.25f;
+                uint32_t oldChild = 0;
+                if (item.hasOld)
+                {
+                    energy = recorded[item.oldIndex * 4 + q].load(std::memory_order_relaxed);
+                    oldChild = nodes[item.oldIndex].child[q];
+                }
+                result.nodes[item.newIndex].sum[q] = energy;
+                if (item.depth < maxDepth && energy > threshold * total)
+                {
+                    uint32_t child = static_cast<uint32_t>(result.nodes.size());
+                    result.nodes.emplace_back();
+                    result.nodes[item.newIndex].child[q] = child;
+                    stack.push_back({child, oldChild, item.hasOld && oldChild != 0, energy, item.depth + 1});
+                }
+            }
+        }
+        return result;
+    }
+
+    void SDTree::Leaf::resetRecording()
+    {
+        recorded = std::make_unique<std::atomic<float>[]>(sampling.nodes.size() * 4);
+        samples.store(0, std::memory_order_relaxed);
+    }
+
+    void SDTree::reset(const vec3 &pMin, const vec3 &pMax)
+    {
+        vec3 padding = (pMax - pMin) * 1e-3f + vec3(1e-4f);
+        boundsMin = pMin - padding;
+        boundsMax = pMax + padding;
+        nodes.assign(1, SNode());
+        leaves.clear();
+        leaves.push_back(std::make_unique<Leaf>());
+        leaves[0]->resetRecording();
+        iteration = 0;
+        passInIteration = 0;
+        updateMemory();
+    }
+
+    SDTree::Leaf *SDTree::findLeaf(const vec3 &pos) const
+    {
+        vec3 lo = boundsMin;
+        vec3 hi = boundsMax;
+        vec3 p = glm::clamp(pos, lo, hi);
+        uint32_t index = 0;
+        while (nodes[index].child[0] != 0)
+        {
+            const SNode &node = nodes[index];
+            float mid = (lo[node.axis] + hi[node.axis]) * 0.5f;
+            if (p[node.axis] < mid)
+            {
+                hi[node.axis] = mid;
+                index = node.child[0];
+            }
+            else
+            {
+                lo[node.axis] = mid;
+                index = node.child[1];
+            }
+        }
+        return leaves[nodes[index].leaf].get();
+    }
+
+    const DTree *SDTree::distribution(const vec3 &pos) const
+    {
+        if (leaves.empty())
+        {
+            return nullptr;
+        }
+        const DTree &tree = findLeaf(pos)->sampling;
+        return tree.valid() ? &tree : nullptr;
+    }
+
+    void SDTree::record(const vec3 &pos, const vec3 &dir, float value)
+    {
+        if (!training() || leaves.empty() || !(value > 0.0f) || !std::isfinite(value))
+        {
+            return;
+        }
+        Leaf *leaf = findLeaf(pos);
+        leaf->sampling.record(leaf->recorded.get(), dir, value);
+        leaf->samples.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // 采样数超过阈值的叶一分为二, 两半各继承一份方向记录与一半的采样数, 直到低于阈值
+    void SDTree::subdivide(uint32_t nodeIndex, float threshold, int depth)
+    {
+        SNode node = nodes[nodeIndex];
+        if (node.child[0] != 0)
+        {
+            subdivide(node.child[0], threshold, depth + 1);
+            subdivide(node.child[1], threshold, depth + 1);
+            return;
+        }
+        Leaf &leaf = *leaves[node.leaf];
+        uint32_t samples = leaf.samples.load(std::memory_order_relaxed);
+        if (static_cast<float>(samples) <= threshold || depth >= kMaxSpatialDepth)
+        {
+            return;
+        }
+        auto copy = std::make_unique<Leaf>();
+        copy->sampling = leaf.sampling;
+        copy->resetRecording();
+        for (size_t i = 0; i < leaf.sampling.nodes.size() * 4; ++i)
+        {
+            copy->recorded[i].store(leaf.recorded[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+        copy->samples.store(samples / 2, std::memory_order_relaxed);
+        leaf.samples.store(samples / 2, std::memory_order_relaxed);
+
+        SNode left;
+        SNode right;
+        left.axis = right.axis = static_cast<uint8_t>((node.axis + 1) % 3);
+        left.leaf = node.leaf;
+        right.leaf = static_cast<uint32_t>(leaves.size());
+        leaves.push_back(std::move(copy));
+        uint32_t leftIndex = static_cast<uint32_t>(nodes.size());
+        nodes.push_back(left);
+        nodes.push_back(right);
+        nodes[nodeIndex].child[0] = leftIndex;
+        nodes[nodeIndex].child[1] = leftIndex + 1;
+        subdivide(leftIndex, threshold, depth + 1);
+        subdivide(leftIndex + 1, threshold, depth + 1);
+    }
+
+    void SDTree::endPass()
+    {
+        if (!training() || leaves.empty() || ++passInIteration < (1 << iteration))
+        {
+            return;
+        }
+        passInIteration = 0;
+        subdivide(0, kSplitSamples * std::sqrt(static_cast<float>(1 << iteration)), 0);
+        {
+            TaskGroup group(ThreadPool::Global());
+            for (auto &leaf : leaves)
+            {
+                group.run([&leaf]()
+                          {
+                              leaf->sampling = leaf->sampling.rebuild(leaf->recorded.get(), kEnergyThreshold, kMaxDirectionalDepth);
+                              leaf->resetRecording(); });
+            }
+            group.wait();
+        }
+        ++iteration;
+        updateMemory();
+    }
+
+    void SDTree::updateMemory()
+    {
+        size_t bytes = nodes.capacity() * sizeof(SNode) + leaves.capacity() * sizeof(std::unique_ptr<Leaf>);
+        for (const auto &leaf : leaves)
+        {
+            bytes += sizeof(Leaf) + leaf->sampling.nodes.capacity() * sizeof(DTree::Node) +
+                     leaf->sampling.nodes.size() * 4 * sizeof(std::atomic<float>);
+        }
+        memoryTracker.set(bytes, bytes);
+    }
+}
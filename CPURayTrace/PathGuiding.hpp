@@ -0,0 +1,131 @@
+#pragma once
+
+#include "Utils.hpp"
+#include "Random.hpp"
+#include "MemoryRegistry.hpp"
+#include "Materials/Microfacet.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// 路径引导(Müller et al. 2017, Practical Path Guiding)
+// 空间二叉树(按包围盒中点轮流沿 x/y/z 划分)的每个叶持有一棵方向四叉树, 四叉树定义在方向的等面积圆柱映射上,
+// 节点保存四个象限的入射辐射亮度之和, 密度高的象限继续细分; 漫反射点按其分布采样弹射方向, 与 BSDF 采样按 one-sample MIS 混合
+// 训练在线进行: 路径结束后把各漫反射点沿弹射方向的入射辐射亮度记入本轮的四叉树, 第 k 轮持续 2^k 遍,
+// 每轮结束时细分采样数过多的空间叶, 并由本轮的记录重建各叶的方向四叉树, 供下一轮采样
+namespace PathGuiding
+{
+    class DTree
+    {
+    public:
+        struct Node
+        {
+            float sum[4] = {0.0f, 0.0f, 0.0f, 0.0f}; // 象限序号 = 行 * 2 + 列
+            uint32_t child[4] = {0, 0, 0, 0};        // 0 表示该象限是叶
+        };
+        std::vector<Node> nodes{Node()};
+
+        inline bool valid() const { return nodes[0].sum[0] + nodes[0].sum[1] + nodes[0].sum[2] + nodes[0].sum[3] > 0.0f; }
+        // 立体角概率密度
+        float pdf(const vec3 &dir) const;
+        vec3 sample(vec2 u) const;
+        // 沿 dir 经过的每层象限加上 value, recorded 与 nodes 一一对应, 每个节点 4 个
+        void record(std::atomic<float> *recorded, const vec3 &dir, float value) const;
+        // 由按本树拓扑记录的能量建立新树: 占总能量超过 threshold 的象限细分; 没有记录时沿用本树
+        DTree rebuild(const std::atomic<float> *recorded, float threshold, int maxDepth) const;
+    };
+
+    class SDTree
+    {
+    public:
+        static constexpr int kMaxIterations = 8;       // 之后停止训练, 引导分布固定
+        static constexpr float kSplitSamples = 12000.f; // 空间叶的细分阈值, 按本轮遍数的平方根放大
+        static constexpr float kEnergyThreshold = 0.01f;
+        static constexpr int kMaxDirectionalDepth = 20;
+        static constexpr int kMaxSpatialDepth = 24;
+
+        // 以场景包围盒重新开始训练
+        void reset(const vec3 &pMin, const vec3 &pMax);
+        // 一遍结束, 本轮结束时细分并重建; 只能在没有追踪进行时调用
+        void endPass();
+        inline bool training() const { return iteration < kMaxIterations; }
+        inline int currentIteration() const { return iteration; }
+        inline size_t leafCount() const { return leaves.size(); }
+
+        // pos 处用于采样的方向分布, 尚未训练出分布时返回空
+        const DTree *distribution(const vec3 &pos) const;
+        // 记录 pos 处沿 dir 入射的辐射亮度估计, value 为亮度 / 采样该方向的概率密度
+        void record(const vec3 &pos, const vec3 &dir, float value);
+
+    private:
+        struct SNode
+        {
+            uint32_t child[2] = {0, 0}; // 都为 0 时是叶
+            uint32_t leaf = 0;
+            uint8_t axis = 0;
+        };
+        struct Leaf
+        {
+            DTree sampling;
+            std::unique_ptr<std::atomic<float>[]> recorded;
+            std::atomic<uint32_t> samples{0};
+
+            void resetRecording();
+        };
+        std::vector<SNode> nodes;
+        std::vector<std::unique_ptr<Leaf>> leaves;
+        vec3 boundsMin = vec3(0.0f);
+        vec3 boundsMax = vec3(0.0f);
+        int iteration = kMaxIterations;
+        int passInIteration = 0;
+        MemoryRegistry::Tracker memoryTracker{MemoryRegistry::Category::PathGuiding};
+
+        Leaf *findLeaf(const vec3 &pos) const;
+        void subdivide(uint32_t nodeIndex, float threshold, int depth);
+        void updateMemory();
+    };
+
+    // 漫反射 BSDF 与引导分布的混合, 接口与 ShadingBsdf 相同, 光源与天空采样据此计算 MIS 权重
+    struct GuidedBsdf
+    {
+        const ShadingBsdf &bsdf;
+        const DTree &guide;
+        float bsdfFraction;
+        vec3 normal;
+
+        GuidedBsdf(const ShadingBsdf &_bsdf, const DTree &_guide, float _bsdfFraction)
+            : bsdf(_bsdf), guide(_guide), bsdfFraction(_bsdfFraction), normal(_bsdf.normal) {}
+
+        inline bool isSpecular() const { return false; }
+
+        inline vec3 evaluate(const vec3 &wi, float &pdf) const
+        {
+            float bsdfPdf;
+            vec3 f = bsdf.evaluate(wi, bsdfPdf);
+            pdf = bsdfFraction * bsdfPdf + (1.0f - bsdfFraction) * guide.pdf(wi);
+            return f;
+        }
+
+        // 返回 f * cos / 混合概率密度; 引导分布可能采到表面以下的方向, 此时返回 0
+        inline vec3 sample(vec3 &wi, float &pdf) const
+        {
+            if (Random::UniformFloat() < bsdfFraction)
+            {
+                float bsdfPdf;
+                if (bsdf.sample(wi, bsdfPdf) == vec3(0.0f))
+                {
+                    pdf = 0.0f;
+                    return vec3(0.0f);
+                }
+            }
+            else
+            {
+                wi = guide.sample(Random::Sample2D());
+            }
+            vec3 f = evaluate(wi, pdf);
+            return pdf > 0.0f ? f / pdf : vec3(0.0f);
+        }
+    };
+}
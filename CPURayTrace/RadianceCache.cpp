@@ -0,0 +1,183 @@
+#include "RadianceCache.hpp"
+#include "Random.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // 单元在相机处约为 cellSize, 远处按距离对数分级, 使单元在屏幕上的大小大致不变
+    constexpr float kLodDistanceScale = 64.0f;
+    constexpr int kMaxLevel = 15;
+
+    inline uint64_t PackCoordinate(int64_t v)
+    {
+        return static_cast<uint64_t>(v) & 0x1fffffULL; // 21 位, 足够覆盖场景范围
+    }
+}
+
+void RadianceCache::allocate()
+{
+    entries = std::make_unique<Entry[]>(kCapacity);
+    inserted = std::make_unique<uint32_t[]>(kCapacity);
+    insertedCount.store(0, std::memory_order_relaxed);
+    occupied.clear();
+    size_t bytes = kCapacity * (sizeof(Entry) + sizeof(uint32_t));
+    memoryTracker.set(bytes, bytes);
+}
+
+uint64_t RadianceCache::key(const vec3 &pos, const vec3 &normal, const vec3 &cameraPos) const
+{
+    float distance = glm::length(pos - cameraPos);
+    int level = std::clamp(static_cast<int>(std::floor(std::log2(std::max(distance / (cellSize * kLodDistanceScale), 1.0f)))), 0, kMaxLevel);
+    float size = cellSize * static_cast<float>(1 << level);
+    // 法线按主轴与符号分成 6 类, 墙角两侧的面不共享单元
+    vec3 a = glm::abs(normal);
+    int axis = a.x > a.y ? (a.x > a.z ? 0 : 2) : (a.y > a.z ? 1 : 2);
+    uint64_t direction = static_cast<uint64_t>(axis * 2 + (normal[axis] < 0.0f ? 1 : 0));
+    uint64_t cell = PackCoordinate(static_cast<int64_t>(std::floor(pos.x / size))) |
+                    PackCoordinate(static_cast<int64_t>(std::floor(pos.y / size))) << 21 |
+                    PackCoordinate(static_cast<int64_t>(std::floor(pos.z / size))) << 42;
+    uint64_t hashed = Random::Hash64(cell ^ Random::Hash64(static_cast<uint64_t>(level) << 3 | direction));
+    return hashed == 0 ? 1 : hashed;
+}
+
+RadianceCache::Entry *RadianceCache::find(uint64_t key)
+{
+    uint32_t bucket = static_cast<uint32_t>(key >> 32) & (kCapacity / kBucketSize - 1);
+    Entry *slots = entries.get() + size_t(bucket) * kBucketSize;
+    for (uint32_t i = 0; i < kBucketSize; ++i)
+    {
+        if (slots[i].key.load(std::memory_order_acquire) == key)
+        {
+            return &slots[i];
+        }
+    }
+    return nullptr;
+}
+
+RadianceCache::Entry *RadianceCache::findOrInsert(uint64_t key)
+{
+    if (Entry *entry = find(key))
+    {
+        return entry;
+    }
+    uint32_t bucket = static_cast<uint32_t>(key >> 32) & (kCapacity / kBucketSize - 1);
+    Entry *slots = entries.get() + size_t(bucket) * kBucketSize;
+    for (uint32_t i = 0; i < kBucketSize; ++i)
+    {
+        uint64_t expected = 0;
+        if (slots[i].key.compare_exchange_strong(expected, key, std::memory_order_acq_rel))
+        {
+            inserted[insertedCount.fetch_add(1, std::memory_order_relaxed)] = static_cast<uint32_t>(&slots[i] - entries.get());
+            return &slots[i];
+        }
+        if (expected == key)
+        {
+            return &slots[i];
+        }
+    }
+    return nullptr;
+}
+
+bool RadianceCache::query(uint64_t key, vec3 &radiance)
+{
+    if (!entries)
+    {
+        return false;
+    }
+    Entry *entry = find(key);
+    if (!entry)
+    {
+        return false;
+    }
+    entry->lastAccess.store(frame, std::memory_order_relaxed);
+    if (entry->samples < kMinSamples)
+    {
+        return false;
+    }
+    radiance = entry->radiance;
+    return true;
+}
+
+void RadianceCache::accumulate(uint64_t key, const vec3 &radiance)
+{
+    if (!entries || !std::isfinite(radiance.r + radiance.g + radiance.b))
+    {
+        return;
+    }
+    Entry *entry = findOrInsert(key);
+    if (!entry)
+    {
+        return; // 桶已满
+    }
+    entry->lastAccess.store(frame, std::memory_order_relaxed);
+    for (int c = 0; c < 3; ++c)
+    {
+        entry->sum[c].fetch_add(radiance[c], std::memory_order_relaxed);
+    }
+    entry->count.fetch_add(1, std::memory_order_relaxed);
+}
+
+void RadianceCache::resolve()
+{
+    if (!entries)
+    {
+        allocate();
+    }
+    ++frame;
+    // 上一遍新插入的槽与仍存活的槽合并后逐个结算, 淘汰的槽不再留在列表中
+    uint32_t insertedSize = insertedCount.exchange(0, std::memory_order_relaxed);
+    occupied.insert(occupied.end(), inserted.get(), inserted.get() + insertedSize);
+    size_t kept = 0;
+    for (uint32_t index : occupied)
+    {
+        Entry &entry = entries[index];
+        uint32_t count = entry.count.exchange(0, std::memory_order_relaxed);
+        if (count > 0)
+        {
+            vec3 mean(entry.sum[0].exchange(0.0f, std::memory_order_relaxed),
+                      entry.sum[1].exchange(0.0f, std::memory_order_relaxed),
+                      entry.sum[2].exchange(0.0f, std::memory_order_relaxed));
+            mean /= static_cast<float>(count);
+            entry.samples = std::min(entry.samples + static_cast<float>(count), kMaxSamples);
+            entry.radiance += (mean - entry.radiance) * (static_cast<float>(count) / std::max(entry.samples, static_cast<float>(count)));
+        }
+        else if (frame - entry.lastAccess.load(std::memory_order_relaxed) > kMaxAge)
+        {
+            entry.radiance = vec3(0.0f);
+            entry.samples = 0.0f;
+            entry.key.store(0, std::memory_order_relaxed);
+            continue;
+        }
+        occupied[kept++] = index;
+    }
+    occupied.resize(kept);
+    entryCount = static_cast<uint32_t>(kept);
+}
+
+void RadianceCache::clear()
+{
+    if (!entries)
+    {
+        allocate();
+        entryCount = 0;
+        return;
+    }
+    uint32_t insertedSize = insertedCount.exchange(0, std::memory_order_relaxed);
+    occupied.insert(occupied.end(), inserted.get(), inserted.get() + insertedSize);
+    for (uint32_t index : occupied)
+    {
+        Entry &entry = entries[index];
+        entry.key.store(0, std::memory_order_relaxed);
+        entry.count.store(0, std::memory_order_relaxed);
+        for (auto &sum : entry.sum)
+        {
+            sum.store(0.0f, std::memory_order_relaxed);
+        }
+        entry.radiance = vec3(0.0f);
+        entry.samples = 0.0f;
+    }
+    occupied.clear();
+    entryCount = 0;
+}
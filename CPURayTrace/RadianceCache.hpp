@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Utils.hpp"
+#include "MemoryRegistry.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// 世界空间辐射缓存(哈希网格)
+// 按量化的位置与法线朝向把漫反射点映射到网格单元, 单元累计该处出射辐射亮度的路径估计
+// 路径在若干次漫反射弹射之后查询缓存, 单元已有足够采样时直接以缓存值结束路径, 不再递归到 bounceLimit
+// 追踪期间并发查询与累计; 每遍开始时 resolve 把上一遍的累计并入滑动平均, 久未访问的单元被淘汰
+// 表在第一次 clear/resolve 时才分配, 未启用缓存时不占内存; resolve 只遍历已占用的槽
+class RadianceCache
+{
+public:
+    static constexpr uint32_t kCapacity = 1u << 18;
+    static constexpr uint32_t kBucketSize = 8; // 同一哈希桶内线性查找, 桶满时放弃该单元
+    static constexpr float kMinSamples = 8.0f;  // 少于这些采样的单元不用于结束路径
+    static constexpr float kMaxSamples = 64.0f; // 滑动平均的历史上限, 光照变化后能较快更新
+    static constexpr uint32_t kMaxAge = 32;     // 连续多少遍未访问后淘汰
+
+    float cellSize = 0.05f; // 相机附近的单元边长, 距离每加倍一次单元边长加倍
+
+    // (pos, normal) 所在单元的键, cameraPos 决定单元的细分层级; 不会返回 0
+    uint64_t key(const vec3 &pos, const vec3 &normal, const vec3 &cameraPos) const;
+    // 单元已有足够采样时给出缓存的出射辐射亮度; 表尚未分配时总是未命中
+    bool query(uint64_t key, vec3 &radiance);
+    void accumulate(uint64_t key, const vec3 &radiance);
+
+    // 以下只能在没有追踪进行时调用
+    void resolve();
+    void clear();
+    inline uint32_t size() const { return entryCount; }
+
+private:
+    struct Entry
+    {
+        std::atomic<uint64_t> key{0};
+        std::atomic<float> sum[3] = {0.0f, 0.0f, 0.0f};
+        std::atomic<uint32_t> count{0};
+        std::atomic<uint32_t> lastAccess{0};
+        // 只在 resolve 中写入
+        vec3 radiance = vec3(0.0f);
+        float samples = 0.0f;
+    };
+    std::unique_ptr<Entry[]> entries;
+    std::vector<uint32_t> occupied;             // 上次 resolve 后仍在使用的槽
+    std::unique_ptr<uint32_t[]> inserted;       // 本遍追踪中新占用的槽, 每个槽在被淘汰前只会插入一次
+    std::atomic<uint32_t> insertedCount{0};
+    uint32_t frame = 0;
+    uint32_t entryCount = 0;
+    MemoryRegistry::Tracker memoryTracker{MemoryRegistry::Category::RadianceCache};
+
+    void allocate();
+    Entry *find(uint64_t key);
+    Entry *findOrInsert(uint64_t key);
+};
@@ -0,0 +1,180 @@
+#include "Restir.hpp"
+#include "EnvironmentMap.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Restir
+{
+    namespace
+    {
+        inline float Luminance(const vec3 &c)
+        {
+            return 0.2126f * c.r + 0.7152f * c.g + 0.0722f * c.b;
+        }
+    }
+
+    ShadingBsdf Surface::bsdf() const
+    {
+        if (matFlags == sd::MetalMat)
+        {
+            return ShadingBsdf::Glossy(normal, wo, albedo, roughness);
+        }
+        return ShadingBsdf::Diffuse(normal, albedo);
+    }
+
+    bool Reservoir::update(const LightSample &candidate, float weight, float candidateTargetPdf, float u)
+    {
+        M += 1.0f;
+        if (!(weight > 0.0f))
+        {
+            return false;
+        }
+        weightSum += weight;
+        if (u * weightSum < weight)
+        {
+            sample = candidate;
+            targetPdf = candidateTargetPdf;
+            return true;
+        }
+        return false;
+    }
+
+    bool Reservoir::merge(const Reservoir &other, float candidateTargetPdf, float u)
+    {
+        M += other.M;
+        float weight = candidateTargetPdf * other.W * other.M;
+        if (!(weight > 0.0f))
+        {
+            return false;
+        }
+        weightSum += weight;
+        if (u * weightSum < weight)
+        {
+            sample = other.sample;
+            targetPdf = candidateTargetPdf;
+            return true;
+        }
+        return false;
+    }
+
+    void Reservoir::finalize()
+    {
+        W = (targetPdf > 0.0f && M > 0.0f) ? weightSum / (M * targetPdf) : 0.0f;
+    }
+
+    Surface MakeSurface(const sd::DataStorage &dataStorage, const Ray &ray, const sd::HitInfos &hit)
+    {
+        Surface surface;
+        if (!hit.hit || (hit.matFlags != sd::LambertianMat && hit.matFlags != sd::MetalMat))
+        {
+            return surface;
+        }
+        const auto &triangle = dataStorage.triangleStorage.triangles[hit.triangleIndex];
+        surface.pos = hit.pos;
+        surface.normal = hit.normal;
+        surface.wo = -glm::normalize(ray.getDirection());
+        surface.albedo = triangle.albedo;
+        surface.roughness = hit.matFlags == sd::MetalMat ? triangle.roughness : 1.0f;
+        surface.depth = glm::length(hit.pos - ray.getOrigin());
+        surface.matFlags = hit.matFlags;
+        surface.valid = !surface.bsdf().isSpecular(); // 镜面的直接光照只能靠 BSDF 采样
+        return surface;
+    }
+
+    bool Similar(const Surface &a, const Surface &b)
+    {
+        if (!a.valid || !b.valid || a.matFlags != b.matFlags)
+        {
+            return false;
+        }
+        return glm::dot(a.normal, b.normal) > 0.9f && std::abs(a.depth - b.depth) <= 0.1f * a.depth;
+    }
+
+    vec3 Contribution(const sd::DataStorage &dataStorage, const EnvironmentMap *environment, const Surface &surface, const LightSample &sample)
+    {
+        float bsdfPdf;
+        if (sample.isSky())
+        {
+            if (!environment)
+            {
+                return vec3(0.0f);
+            }
+            return surface.bsdf().evaluate(sample.position, bsdfPdf) * environment->lookup(sample.position);
+        }
+        vec3 toLight = sample.position - surface.pos;
+        float distance2 = glm::dot(toLight, toLight);
+        if (distance2 <= 1e-12f)
+        {
+            return vec3(0.0f);
+        }
+        vec3 wi = toLight / std::sqrt(distance2);
+        float cosLight = std::abs(glm::dot(sample.normal, wi)); // 双面发光
+        vec3 f = surface.bsdf().evaluate(wi, bsdfPdf);
+        return f * dataStorage.triangleStorage.triangles[sample.triangleIndex].emission * (cosLight / distance2);
+    }
+
+    float TargetPdf(const sd::DataStorage &dataStorage, const EnvironmentMap *environment, const Surface &surface, const LightSample &sample)
+    {
+        return Luminance(Contribution(dataStorage, environment, surface, sample));
+    }
+
+    // 源分布是发光三角形(面积测度)与天空(立体角测度)的不交并, 两部分的 p̂ 与源概率密度各自使用同一测度
+    Reservoir SampleCandidates(const sd::DataStorage &dataStorage, const EnvironmentMap *environment, const Surface &surface, int candidates, Random::PCG32 &rng)
+    {
+        Reservoir reservoir;
+        const bool hasEmitters = !dataStorage.emitters.empty();
+        const float skyProbability = environment ? (hasEmitters ? 0.5f : 1.0f) : 0.0f;
+        if (!hasEmitters && skyProbability <= 0.0f)
+        {
+            return reservoir;
+        }
+        for (int i = 0; i < candidates; ++i)
+        {
+            LightSample candidate;
+            float sourcePdf;
+            if (rng.nextFloat() < skyProbability)
+            {
+                float skyPdf;
+                candidate.position = environment->sample(rng.nextFloat(), rng.nextFloat(), skyPdf);
+                sourcePdf = skyProbability * skyPdf;
+            }
+            else
+            {
+                candidate.triangleIndex = dataStorage.emitters.sample(rng.nextFloat());
+                sd::SampleTriangle(dataStorage.triangleStorage.triangles[candidate.triangleIndex], rng.nextFloat(), rng.nextFloat(), candidate.position, candidate.normal);
+                sourcePdf = (1.0f - skyProbability) * dataStorage.emitters.pdfArea();
+            }
+            float targetPdf = sourcePdf > 0.0f ? TargetPdf(dataStorage, environment, surface, candidate) : 0.0f;
+            reservoir.update(candidate, sourcePdf > 0.0f ? targetPdf / sourcePdf : 0.0f, targetPdf, rng.nextFloat());
+        }
+        reservoir.finalize();
+        return reservoir;
+    }
+
+    vec3 Shade(const sd::DataStorage &dataStorage, const EnvironmentMap *environment, const Surface &surface, Reservoir &reservoir)
+    {
+        if (reservoir.W <= 0.0f)
+        {
+            return vec3(0.0f);
+        }
+        vec3 origin = surface.pos + surface.normal * 1e-5f; // 防止自相交
+        bool occluded;
+        if (reservoir.sample.isSky())
+        {
+            occluded = sd::BVH::IntersectAny(dataStorage, Ray(origin, reservoir.sample.position), std::numeric_limits<float>::infinity());
+        }
+        else
+        {
+            vec3 toLight = reservoir.sample.position - surface.pos;
+            float distance = glm::length(toLight);
+            occluded = sd::BVH::IntersectAny(dataStorage, Ray(origin, toLight / distance), distance * (1.0f - 1e-3f));
+        }
+        if (occluded)
+        {
+            reservoir.W = 0.0f;
+            return vec3(0.0f);
+        }
+        return Contribution(dataStorage, environment, surface, reservoir.sample) * reservoir.W;
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Utils.hpp"
+#include "Ray.hpp"
+#include "Random.hpp"
+#include "SimplifiedData.hpp"
+#include "Materials/Microfacet.hpp"
+
+#include <limits>
+
+class EnvironmentMap;
+
+// 主光线命中点直接光照的蓄水池重采样(ReSTIR DI)
+// 每个像素先由廉价的候选(按面积选发光三角形上的点, 按亮度选天空方向)做 RIS 得到一个光源样本,
+// 再并入上一遍同一表面点的蓄水池(时域)与屏幕邻域的蓄水池(空域), 最后只对选中的样本投射一条阴影光线
+// 目标函数为不含可见性的 f * cos * Le * G 的亮度; 复用时不检查可见性, 按 M 加权合并, 有少量偏差
+namespace Restir
+{
+    // 光源样本: 发光三角形上的一点, 或者天空方向(triangleIndex 为 invalidIndex, position 保存方向)
+    // 只存几何, 亮度在使用时按当前场景与天空重新取得
+    struct LightSample
+    {
+        vec3 position = vec3(0.0f);
+        vec3 normal = vec3(0.0f);
+        uint32_t triangleIndex = sd::invalidIndex;
+
+        inline bool isSky() const { return triangleIndex == sd::invalidIndex; }
+    };
+
+    // 主光线命中的着色点, 足以重建 BSDF 与判断复用是否合适
+    struct Surface
+    {
+        vec3 pos = vec3(0.0f);
+        vec3 normal = vec3(0.0f);
+        vec3 wo = vec3(0.0f);
+        vec3 albedo = vec3(0.0f);
+        float roughness = 0.0f;
+        float depth = std::numeric_limits<float>::infinity(); // 相机到命中点的距离
+        uint16_t matFlags = sd::LambertianMat;
+        bool valid = false; // 未命中, 命中光源或镜面时无效, 路径按原方式估计直接光照
+
+        ShadingBsdf bsdf() const;
+    };
+
+    struct Reservoir
+    {
+        LightSample sample;
+        float weightSum = 0.0f;
+        float M = 0.0f;         // 见过的候选数
+        float W = 0.0f;         // 选中样本的贡献权重 weightSum / (M * p̂)
+        float targetPdf = 0.0f; // 选中样本在所属着色点的目标函数值 p̂
+
+        // 流式加入一个候选, weight = p̂ / 源概率密度
+        bool update(const LightSample &candidate, float weight, float candidateTargetPdf, float u);
+        // 并入另一个蓄水池, candidateTargetPdf 为其样本在本着色点的目标函数值
+        bool merge(const Reservoir &other, float candidateTargetPdf, float u);
+        void finalize();
+    };
+
+    Surface MakeSurface(const sd::DataStorage &dataStorage, const Ray &ray, const sd::HitInfos &hit);
+    // 法线与深度相近的表面才互相复用
+    bool Similar(const Surface &a, const Surface &b);
+
+    // 不含可见性的 f * cos * Le * G, 天空样本的 G 为 1
+    vec3 Contribution(const sd::DataStorage &dataStorage, const EnvironmentMap *environment, const Surface &surface, const LightSample &sample);
+    float TargetPdf(const sd::DataStorage &dataStorage, const EnvironmentMap *environment, const Surface &surface, const LightSample &sample);
+
+    // 生成 candidates 个候选做 RIS, environment 为空时只取发光三角形
+    Reservoir SampleCandidates(const sd::DataStorage &dataStorage, const EnvironmentMap *environment, const Surface &surface, int candidates, Random::PCG32 &rng);
+    // 投射阴影光线, 返回 f * cos * Le * G * W; 被遮挡时把 W 置 0, 下一遍不再复用这个样本
+    vec3 Shade(const sd::DataStorage &dataStorage, const EnvironmentMap *environment, const Surface &surface, Reservoir &reservoir);
+}
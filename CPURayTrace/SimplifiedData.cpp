@@ -1,10 +1,13 @@
 #include "SimplifiedData.hpp"
+#include "Materials/LightEmit.hpp"
+#include "Materials/Metal.hpp"
+#include "Materials/Lambertian.hpp"
 
 #include <exception>
 namespace SimplifiedData
 {
     TriangleStorage::TriangleStorage()
-        : triangles(TRIANGLESIZE)
+        : triangles(TRIANGLESIZE, MemoryRegistry::Category::TriangleStorage)
     {
     }
 
@@ -17,8 +20,9 @@ namespace SimplifiedData
         }
         if (nextIndex < TRIANGLESIZE)
         {
-            this->triangles[nextIndex++] = _triangle;
+            this->triangles.set(nextIndex++, _triangle);
         }
+        memoryTracker.set(0, size_t(nextIndex) * sizeof(Triangle));
         return nextIndex - 1;
     }
 
@@ -32,8 +36,9 @@ namespace SimplifiedData
         }
         for (const auto &tri : _triangles)
         {
-            this->triangles[this->nextIndex++] = tri;
+            this->triangles.set(this->nextIndex++, tri);
         }
+        memoryTracker.set(0, size_t(nextIndex) * sizeof(Triangle));
         return startIndex;
     }
 
@@ -42,7 +47,7 @@ namespace SimplifiedData
     }
 
     NodeStorage::NodeStorage()
-        : nodes(NODESIZE) // 全分配,因为BVH构建时需要从后往前添加节点
+        : nodes(NODESIZE, MemoryRegistry::Category::NodeStorage) // 页表全分配,因为BVH构建时需要从后往前添加节点; 页面按需分配
     {
     }
 
@@ -56,8 +61,9 @@ namespace SimplifiedData
 
         if (nextIndex < nodes.size())
         {
-            nodes[nextIndex++] = _node;
+            nodes.set(nextIndex++, _node);
         }
+        memoryTracker.set(0, size_t(nextIndex + (NODESIZE - 1 - nextIndexBack)) * sizeof(Node));
         return nextIndex - 1;
     }
 
@@ -69,8 +75,9 @@ namespace SimplifiedData
         }
         if (nextIndexBack >= nextIndex)
         {
-            nodes[nextIndexBack--] = _node;
+            nodes.set(nextIndexBack--, _node);
         }
+        memoryTracker.set(0, size_t(nextIndex + (NODESIZE - 1 - nextIndexBack)) * sizeof(Node));
         return nextIndexBack + 1;
     }
 
@@ -83,8 +90,9 @@ namespace SimplifiedData
         }
         for (const auto &node : _nodes)
         {
-            this->nodes[nextIndex++] = node;
+            this->nodes.set(nextIndex++, node);
         }
+        memoryTracker.set(0, size_t(nextIndex + (NODESIZE - 1 - nextIndexBack)) * sizeof(Node));
         return startIndex;
     }
 
@@ -92,6 +100,41 @@ namespace SimplifiedData
     {
     }
 
+    DataStorage DataStorage::replicateTopLevels(int numaNode, int depth) const
+    {
+        DataStorage replica = *this;
+        if (rootIndex == invalidIndex)
+        {
+            return replica;
+        }
+        using NodePages = decltype(nodeStorage.nodes);
+        std::vector<bool> localized(nodeStorage.nodes.pageCount(), false);
+        std::vector<std::pair<uint32_t, int>> stack{{rootIndex, 0}};
+        while (!stack.empty())
+        {
+            auto [index, level] = stack.back();
+            stack.pop_back();
+            if (index == invalidIndex || level > depth)
+            {
+                continue;
+            }
+            size_t pageIndex = index >> NodePages::kPageBits;
+            if (!localized[pageIndex])
+            {
+                replica.nodeStorage.nodes.localizePage(pageIndex, numaNode);
+                localized[pageIndex] = true;
+            }
+            const Node &node = nodeStorage.nodes[index];
+            if (node.flags == NODE_LEAF)
+            {
+                continue;
+            }
+            stack.push_back({node.left, level + 1});
+            stack.push_back({node.right, level + 1});
+        }
+        return replica;
+    }
+
     // Mesh 构造函数定义
     // 构造叶子节点
     // 将三角形数据加入存储区
@@ -100,6 +143,26 @@ namespace SimplifiedData
         auto &triangleStorage = dataStroage.triangleStorage;
         auto &nodeStorage = dataStroage.nodeStorage;
 
+        uint16_t matFlags = LambertianMat;
+        vec3 emission(0.0f);
+        vec3 albedo = Triangle().albedo;
+        float roughness = 0.0f;
+        if (auto *light = dynamic_cast<const LightEmit *>(&_material))
+        {
+            matFlags = LightEmitMat;
+            emission = vec3(light->intensity);
+        }
+        else if (auto *metal = dynamic_cast<const Metal *>(&_material))
+        {
+            matFlags = MetalMat;
+            albedo = vec3(metal->albedo);
+            roughness = metal->gross;
+        }
+        else if (auto *lambertian = dynamic_cast<const Lambertian *>(&_material))
+        {
+            albedo = vec3(lambertian->albedo);
+        }
+
         std::vector<uint32_t> nodeIndices;
         for (uint32_t i = 0; i < indices.size(); i += 3)
         {
@@ -116,8 +179,15 @@ namespace SimplifiedData
             tri.texCoords[0] = v0.texCoord;
             tri.texCoords[1] = v1.texCoord;
             tri.texCoords[2] = v2.texCoord;
-            tri.matFlags = LambertianMat; // TODO
+            tri.matFlags = matFlags;
+            tri.emission = emission;
+            tri.albedo = albedo;
+            tri.roughness = roughness;
             uint32_t triangleIndex = triangleStorage.addTriangle(tri);
+            if (matFlags == LightEmitMat)
+            {
+                dataStroage.emitters.add(triangleIndex, TriangleArea(tri));
+            }
 
             Node leafNode;
             leafNode.left = triangleIndex;
@@ -167,11 +237,11 @@ namespace SimplifiedData
 
         flatNodeStorage.nodes.resize(count * stride);
 
-        const auto *src = nodeStorage.nodes.data();
         float *dst = flatNodeStorage.nodes.data();
 
-        for (size_t i = 0; i < count; ++i, ++src, dst += stride)
+        for (size_t i = 0; i < count; ++i, dst += stride)
         {
+            const auto *src = &nodeStorage.nodes[i];
             dst[0] = glm::uintBitsToFloat(src->left);
             dst[1] = glm::uintBitsToFloat(src->right);
             dst[2] = src->box.pMin.x;
@@ -191,11 +261,11 @@ namespace SimplifiedData
 
         flatTriangleStorage.triangles.resize(count * stride);
 
-        const auto *src = triangleStorage.triangles.data();
         float *dst = flatTriangleStorage.triangles.data();
 
-        for (size_t i = 0; i < count; ++i, ++src, dst += stride)
+        for (size_t i = 0; i < count; ++i, dst += stride)
         {
+            const auto *src = &triangleStorage.triangles[i];
             float *vertexDst = dst;
             for (int v = 0; v < 3; ++v, vertexDst += 8)
             {
@@ -220,6 +290,8 @@ namespace SimplifiedData
         ConvertNodeToFlatStorage(dataStorage.nodeStorage, flatNodeStorage);
         ConvertTriangleToFlatStorage(dataStorage.triangleStorage, flatTriangleStorage);
         flatNodeStorage.rootIndex = dataStorage.rootIndex;
+        flatNodeStorage.updateMemoryUsage();
+        flatTriangleStorage.updateMemoryUsage();
     }
     Node GetNodeFromFlatStorage(const FlatNodeStorage &flatNodeStorage, size_t index)
     {
@@ -305,6 +377,38 @@ namespace SimplifiedData
         else // This means that there is a line intersection but not a ray intersection.
             return HitInfos{};
     }
+
+    float TriangleArea(const Triangle &triangle)
+    {
+        return 0.5f * glm::length(glm::cross(triangle.positions[1] - triangle.positions[0], triangle.positions[2] - triangle.positions[0]));
+    }
+
+    void SampleTriangle(const Triangle &triangle, float u1, float u2, glm::vec3 &position, glm::vec3 &normal)
+    {
+        float su = std::sqrt(u1);
+        float b0 = 1.0f - su;
+        float b1 = u2 * su;
+        position = b0 * triangle.positions[0] + b1 * triangle.positions[1] + (1.0f - b0 - b1) * triangle.positions[2];
+        normal = glm::normalize(glm::cross(triangle.positions[1] - triangle.positions[0], triangle.positions[2] - triangle.positions[0]));
+    }
+
+    void EmitterList::add(uint32_t triangleIndex, float area)
+    {
+        if (area <= 0.0f)
+        {
+            return; // 退化三角形不可能被采样到
+        }
+        triangles.push_back(triangleIndex);
+        cdf.push_back(totalArea() + area);
+    }
+
+    uint32_t EmitterList::sample(float u) const
+    {
+        auto it = std::upper_bound(cdf.begin(), cdf.end(), u * totalArea());
+        size_t index = std::min(static_cast<size_t>(it - cdf.begin()), triangles.size() - 1);
+        return triangles[index];
+    }
+
     // GetBoundingBox
     BoundingBox GetBoundingBox(const Triangle &triangle)
     {
@@ -321,7 +425,7 @@ namespace SimplifiedData
 
     uint32_t BVH::BuildBVHFromNodes(NodeStorage &nodeStorage, uint32_t *nodeIndices, size_t start, size_t end)
     {
-        auto &nodes = nodeStorage.nodes;
+        const auto &nodes = nodeStorage.nodes;
         if (end - start <= 0)
             // return sd::invalidIndex;
             throw std::runtime_error("Build Failed. end - start <= 0 ");
@@ -398,14 +502,18 @@ namespace SimplifiedData
         return nodeIndex;
     }
 
-    HitInfos BVH::Intersect(DataStorage &dataStorage, const Ray &ray)
+    HitInfos BVH::Intersect(const DataStorage &dataStorage, const Ray &ray)
     {
 
         HitInfos closestHit;
         auto traverse = [&ray, &closestHit, &dataStorage](auto &&traverseSelf, uint32_t nodeIndex) -> void
         {
+            if (nodeIndex == sd::invalidIndex)
+            {
+                return;
+            }
             Node node = dataStorage.nodeStorage.nodes[nodeIndex];
-            if (nodeIndex == sd::invalidIndex || !sd::IntersectBoundingBox(node.box, ray, 1e-6f, closestHit.t))
+            if (!sd::IntersectBoundingBox(node.box, ray, 1e-6f, closestHit.t))
             {
                 return;
             }
@@ -417,6 +525,7 @@ namespace SimplifiedData
                 if (hitInfos.hit && hitInfos.t < closestHit.t) // 代替原来的命中物体收集
                 {
                     closestHit = hitInfos;
+                    closestHit.triangleIndex = node.left;
                 }
                 return;
             }
@@ -427,7 +536,7 @@ namespace SimplifiedData
         return closestHit;
     }
 
-    HitInfos BVH::IntersectLoop(DataStorage &dataStorage, const Ray &ray)
+    HitInfos BVH::IntersectLoop(const DataStorage &dataStorage, const Ray &ray)
     {
         static thread_local std::array<uint32_t, 32> callStack; // 假设栈深度不会超过32
         static thread_local size_t top = 0;
@@ -438,9 +547,13 @@ namespace SimplifiedData
         while (top > 0)
         {
             uint32_t index = callStack[--top];
+            if (index == sd::invalidIndex)
+            {
+                continue;
+            }
             const Node &node = dataStorage.nodeStorage.nodes[index];
 
-            if (index == sd::invalidIndex || !sd::IntersectBoundingBox(node.box, ray, 1e-6f, closestHit.t))
+            if (!sd::IntersectBoundingBox(node.box, ray, 1e-6f, closestHit.t))
             {
                 continue;
             }
@@ -452,6 +565,7 @@ namespace SimplifiedData
                 if (hitInfos.hit && hitInfos.t < closestHit.t) // 代替原来的命中物体收集
                 {
                     closestHit = hitInfos;
+                    closestHit.triangleIndex = node.left;
                 }
                 continue;
             }
@@ -461,14 +575,47 @@ namespace SimplifiedData
         return closestHit;
     }
 
+    bool BVH::IntersectAny(const DataStorage &dataStorage, const Ray &ray, float tMax)
+    {
+        std::array<uint32_t, 32> stack;
+        size_t top = 0;
+        stack[top++] = dataStorage.rootIndex;
+        while (top > 0)
+        {
+            uint32_t index = stack[--top];
+            if (index == sd::invalidIndex)
+            {
+                continue;
+            }
+            const Node &node = dataStorage.nodeStorage.nodes[index];
+            if (!sd::IntersectBoundingBox(node.box, ray, 1e-6f, tMax))
+            {
+                continue;
+            }
+            if (node.flags == NODE_LEAF)
+            {
+                if (sd::IntersectTriangle(dataStorage.triangleStorage.triangles[node.left], ray, 1e-6f, tMax).t < tMax)
+                {
+                    return true; // 任意命中即可提前结束
+                }
+                continue;
+            }
+            stack[top++] = node.left;
+            stack[top++] = node.right;
+        }
+        return false;
+    }
+
     FlatNodeStorage::FlatNodeStorage()
         : nodes(NODESIZE * kFloatsPerNode)
     {
+        updateMemoryUsage();
     }
 
     FlatTriangleStorage::FlatTriangleStorage()
         : triangles(TRIANGLESIZE * kFloatsPerTriangle)
     {
+        updateMemoryUsage();
     }
 
 } // namespace SimplifiedData
@@ -3,6 +3,9 @@
 #include "Materials.hpp"
 #include "Ray.hpp"
 #include "Utils.hpp"
+#include "PagedArray.hpp"
+#include "MemoryRegistry.hpp"
+#include "LightTree.hpp"
 
 #include <optional>
 #include <vector>
@@ -59,6 +62,7 @@ namespace SimplifiedData
         glm::vec3 pos;                                    // 命中位置
         glm::vec3 normal;                                 // 归一化世界法线
         uint16_t matFlags;                                // 材质
+        uint32_t triangleIndex = invalidIndex;            // 命中三角形在 TriangleStorage 中的序号
     };
 
     struct BoundingBox
@@ -85,18 +89,23 @@ namespace SimplifiedData
         vec3 normals[3];
         vec2 texCoords[3];
         uint16_t matFlags;
+        vec3 emission = vec3(0.0f); // LightEmitMat 的辐射亮度, 双面发光
+        vec3 albedo = vec3(0.9f, 0.6f, 0.5f); // LambertianMat 的漫反射率, MetalMat 的 F0; 材质未提供时使用此默认值
+        float roughness = 0.0f;               // MetalMat 的 GGX 粗糙度
     };
 
     inline constexpr uint32_t TRIANGLESIZE = 1 << 20;          // 2^21 = 2097152 个三角形  不要用一个数组分配太大内存 否则 bad alloc
     inline constexpr uint32_t NODESIZE = TRIANGLESIZE * 2 - 1; // 完全二叉树节点数 = 2*n-1,也就是最大节点数
 
+    // 存储使用分页COW数组, 拷贝存储只拷贝页表, 未修改的网格数据在场景快照之间共享
     class TriangleStorage
     {
     public:
         TriangleStorage();
 
-        std::vector<Triangle> triangles;
+        PagedArray<Triangle, 15> triangles; // sizeof(Triangle) 为 128 字节, 每页 4MB, 正好两个 2MB 大页
         uint32_t nextIndex = 0;
+        MemoryRegistry::Tracker memoryTracker{MemoryRegistry::Category::TriangleStorage}; // 只统计 used, reserved 由页面分配器统计
         uint32_t addTriangle(const sd::Triangle &triangle);
         uint32_t addTriangleArray(std::vector<sd::Triangle> &triangles);
 
@@ -110,9 +119,10 @@ namespace SimplifiedData
     public:
         NodeStorage();
 
-        std::vector<Node> nodes;
+        PagedArray<Node, 16> nodes; // 每页约2.4MB
         uint32_t nextIndex = 0;
         uint32_t nextIndexBack = NODESIZE - 1;
+        MemoryRegistry::Tracker memoryTracker{MemoryRegistry::Category::NodeStorage}; // 只统计 used, reserved 由页面分配器统计
         uint32_t addNode(const sd::Node &node);
         uint32_t addNodeBack(const sd::Node &node);
         uint32_t addLeafNodeArray(const std::vector<sd::Node> &nodes);
@@ -120,12 +130,34 @@ namespace SimplifiedData
         ~NodeStorage();
     };
 
+    // 发光三角形列表, 按面积构建 CDF 用于光源采样(next-event estimation)
+    // 按面积选择三角形再在其上均匀取点, 发光表面上每一点的面积概率密度都是 1 / 总面积
+    class EmitterList
+    {
+    public:
+        std::vector<uint32_t> triangles; // 发光三角形在 TriangleStorage 中的序号
+        std::vector<float> cdf;          // 面积的前缀和, 最后一个元素为总面积
+
+        inline bool empty() const { return triangles.empty(); }
+        inline float totalArea() const { return cdf.empty() ? 0.0f : cdf.back(); }
+        inline float pdfArea() const { return cdf.empty() ? 0.0f : 1.0f / cdf.back(); }
+
+        void add(uint32_t triangleIndex, float area);
+        // u ∈ [0,1), 返回被选中三角形在 TriangleStorage 中的序号
+        uint32_t sample(float u) const;
+    };
+
     struct DataStorage
     {
     public:
         TriangleStorage triangleStorage;
         NodeStorage nodeStorage;
-        uint32_t rootIndex;
+        EmitterList emitters;
+        LightTree lightTree; // 由 emitters 构建, 发光三角形改变后需要重建
+        uint32_t rootIndex = invalidIndex;
+
+        // 生成绑定到 numaNode 的副本: 从根开始 depth 层以内节点所在的页面复制到该节点, 其余页面共享
+        DataStorage replicateTopLevels(int numaNode, int depth) const;
     };
 
     // 网格到底是什么呢? 网格最终数据结构只是一堆三角形,不是最终实际存储,是一个临时数据结构
@@ -144,11 +176,16 @@ namespace SimplifiedData
         // 收集所有网格节点 拷贝, 然后排序 划分 最终还是指向存储中的索引[start, end)
         /// nodes: ... ... |TN2|TN1| SceneRoot|...|SI3|SI2|SI1|... ...|*Mesh2|M2I1|M2I2...|*Mesh1|M1I1|M1I2...|
         static uint32_t BuildBVHFromNodes(NodeStorage &nodeStorage, uint32_t *nodeIndices, size_t start, size_t end);
-        static HitInfos Intersect(DataStorage &dataStorage, const Ray &ray);
-        static HitInfos IntersectLoop(DataStorage &dataStorage, const Ray &ray);
+        static HitInfos Intersect(const DataStorage &dataStorage, const Ray &ray);
+        static HitInfos IntersectLoop(const DataStorage &dataStorage, const Ray &ray);
+        // 阴影光线: (1e-6, tMax) 内有任意命中即返回 true
+        static bool IntersectAny(const DataStorage &dataStorage, const Ray &ray, float tMax);
     };
 
     sd::BoundingBox GetBoundingBox(const sd::Triangle &triangle);
+    float TriangleArea(const Triangle &triangle);
+    // 在三角形上均匀取一点, normal 为几何法线
+    void SampleTriangle(const Triangle &triangle, float u1, float u2, glm::vec3 &position, glm::vec3 &normal);
     HitInfos IntersectTriangle(const Triangle &tri, const Ray &ray, float tMin, float tMax);
     bool operator==(const HitInfos &hit1, const HitInfos &hit2);
     bool IntersectBoundingBox(const BoundingBox &box, const Ray &ray, float tMin, float tMax);
@@ -162,6 +199,8 @@ namespace SimplifiedData
 
         std::vector<float> nodes;
         uint32_t rootIndex = sd::invalidIndex;
+        MemoryRegistry::Tracker memoryTracker{MemoryRegistry::Category::FlatNodeStorage};
+        inline void updateMemoryUsage() { memoryTracker.set(nodes.capacity() * sizeof(float), nodes.size() * sizeof(float)); }
     };
     struct FlatTriangleStorage
     {
@@ -171,6 +210,8 @@ namespace SimplifiedData
         FlatTriangleStorage();
 
         std::vector<float> triangles;
+        MemoryRegistry::Tracker memoryTracker{MemoryRegistry::Category::FlatTriangleStorage};
+        inline void updateMemoryUsage() { memoryTracker.set(triangles.capacity() * sizeof(float), triangles.size() * sizeof(float)); }
     };
     inline constexpr size_t NODESIZESSBO = NODESIZE * FlatNodeStorage::kFloatsPerNode;
     inline constexpr size_t TRIANGLESIZESSBO = TRIANGLESIZE * FlatTriangleStorage::kFloatsPerTriangle;
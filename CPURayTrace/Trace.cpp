@@ -7,12 +7,136 @@
 #include "Random.hpp"
 #include "Materials/Sky.hpp"
 #include "Materials/Lambertian.hpp"
+#include "Materials/Microfacet.hpp"
 #include "BVHUI.hpp"
 #include "Scene.hpp"
 #include "Trace.hpp"
 #include "SimplifiedData.hpp"
+#include "Shader.hpp"
+#include "UI.hpp"
+#include "EnvironmentMap.hpp"
+#include "RadianceCache.hpp"
+#include "PathGuiding.hpp"
 #include <limits>
 
+namespace
+{
+    // 辐射缓存: 训练路径不在缓存处结束, 保证已收敛的单元仍能得到新的估计
+    constexpr float kCacheTrainingFraction = 0.1f;
+    constexpr int kMaxCacheVertices = 16;
+    constexpr int kMaxGuidingVertices = 16;
+
+    inline float Luminance(const vec3 &c)
+    {
+        return 0.2126f * c.r + 0.7152f * c.g + 0.0722f * c.b;
+    }
+
+    // 幂启发式 MIS 权重
+    inline float PowerHeuristic(float pdf, float otherPdf)
+    {
+        float a = pdf * pdf;
+        float b = otherPdf * otherPdf;
+        return a + b > 0.0f ? a / (a + b) : 0.0f;
+    }
+
+    // 选中 triangleIndex 的概率除以其面积, 即该三角形上一点的面积概率密度
+    float EmitterPdfArea(const sd::DataStorage &dataStorage, Trace::LightSelection selection, const sd::HitInfos &from, uint32_t triangleIndex)
+    {
+        if (selection == Trace::LightSelection::Area)
+        {
+            return dataStorage.emitters.pdfArea();
+        }
+        float area = sd::TriangleArea(dataStorage.triangleStorage.triangles[triangleIndex]);
+        return area > 0.0f ? dataStorage.lightTree.pmf(from.pos, from.normal, triangleIndex) / area : 0.0f;
+    }
+
+    // 立体角下的光源采样概率密度: 面积密度 * 距离平方 / 光源处余弦
+    inline float LightPdf(float pdfArea, float distance, float cosLight)
+    {
+        return pdfArea * distance * distance / std::max(cosLight, 1e-6f);
+    }
+
+    // 在着色点选择一个发光三角形, 在其上取一点并投射阴影光线
+    // 返回 MIS 加权后的 f * cos * Le / pdf, 调用方再乘以路径吞吐量; Bsdf 为 ShadingBsdf 或 PathGuiding::GuidedBsdf
+    template <typename Bsdf>
+    vec3 SampleEmitters(const sd::DataStorage &dataStorage, Trace::LightSelection selection, const sd::HitInfos &hit, const Bsdf &bsdf)
+    {
+        const float u = Random::Sample1D(Random::kLightSelect);
+        uint32_t triangleIndex;
+        float pdfArea;
+        if (selection == Trace::LightSelection::Area)
+        {
+            triangleIndex = dataStorage.emitters.sample(u);
+            pdfArea = dataStorage.emitters.pdfArea();
+        }
+        else
+        {
+            float pmf;
+            if (!dataStorage.lightTree.sample(hit.pos, hit.normal, u, triangleIndex, pmf))
+            {
+                return vec3(0.0f); // 没有光源能照到这一点
+            }
+            pdfArea = pmf / sd::TriangleArea(dataStorage.triangleStorage.triangles[triangleIndex]);
+        }
+        const auto &triangle = dataStorage.triangleStorage.triangles[triangleIndex];
+        vec3 lightPos, lightNormal;
+        sd::SampleTriangle(triangle, Random::UniformFloat(), Random::UniformFloat(), lightPos, lightNormal);
+
+        vec3 toLight = lightPos - hit.pos;
+        float distance = glm::length(toLight);
+        if (distance <= 1e-6f)
+        {
+            return vec3(0.0f);
+        }
+        vec3 wi = toLight / distance;
+        float cosLight = std::abs(glm::dot(lightNormal, wi)); // 双面发光
+        float bsdfPdf;
+        vec3 f = bsdf.evaluate(wi, bsdfPdf);
+        if (bsdfPdf <= 0.0f || cosLight <= 1e-6f)
+        {
+            return vec3(0.0f);
+        }
+        vec3 origin = hit.pos + hit.normal * 1e-5f; // 防止自相交
+        if (sd::BVH::IntersectAny(dataStorage, Ray(origin, wi), distance * (1.0f - 1e-3f)))
+        {
+            return vec3(0.0f);
+        }
+        float lightPdf = LightPdf(pdfArea, distance, cosLight);
+        float weight = PowerHeuristic(lightPdf, bsdfPdf);
+        return f * triangle.emission * (weight / lightPdf);
+    }
+
+    // 按天空亮度采样一个方向, occluded(ray) 判断朝天空的阴影光线是否被场景挡住
+    template <typename Bsdf, typename Occluded>
+    vec3 SampleSky(const EnvironmentMap &environment, const vec3 &pos, const Bsdf &bsdf, Occluded &&occluded)
+    {
+        float skyPdf;
+        vec3 wi = environment.sample(Random::UniformFloat(), Random::UniformFloat(), skyPdf);
+        if (skyPdf <= 0.0f)
+        {
+            return vec3(0.0f);
+        }
+        float bsdfPdf;
+        vec3 f = bsdf.evaluate(wi, bsdfPdf);
+        if (bsdfPdf <= 0.0f)
+        {
+            return vec3(0.0f);
+        }
+        if (occluded(Ray(pos + bsdf.normal * 1e-5f, wi)))
+        {
+            return vec3(0.0f);
+        }
+        float weight = PowerHeuristic(skyPdf, bsdfPdf);
+        return f * environment.lookup(wi) * (weight / skyPdf);
+    }
+}
+
+vec3 Trace::SampleEnvironment(const EnvironmentMap &environment, const vec3 &pos, const ShadingBsdf &bsdf, const Scene &scene)
+{
+    return SampleSky(environment, pos, bsdf, [&scene](const Ray &ray)
+                     { return (BVHSettings::toggleBVHAccel ? scene.intersectClosestBVH(ray) : scene.intersectClosest(ray)).t != std::numeric_limits<float>::infinity(); });
+}
+
 color4 Trace::CastRayDirectionLight(const Ray &ray, const color4 &light, const Scene &scene)
 {
     HitInfos closestHit;
@@ -28,8 +152,9 @@ color4 Trace::CastRayDirectionLight(const Ray &ray, const color4 &light, const S
     return light;
 }
 
-color4 Trace::CastRay(const Ray &ray, int traceDepth, const Scene &scene)
+color4 Trace::CastRay(const Ray &ray, int traceDepth, const Scene &scene, float bsdfPdf)
 {
+    Random::SeedBounce(traceDepth);
     float rr = traceDepth <= 1 ? 1.0f : Random::RussianRoulette(0.8f);
 
     if (traceDepth > bounceLimit || rr == 0.0f)
@@ -52,17 +177,85 @@ color4 Trace::CastRay(const Ray &ray, int traceDepth, const Scene &scene)
     Sky sky;
     HitInfos hitSky;
     hitSky.dir = ray.getDirection();
-    return sky.getIrradiance(hitSky, traceDepth, scene) * rr;
+    color4 skyColor = sky.getIrradiance(hitSky, traceDepth, scene);
+    const EnvironmentMap *environment = EnvironmentMap::Current();
+    if (bsdfPdf > 0.0f && environment && EnvironmentMap::importanceSampling.load(std::memory_order_relaxed))
+    {
+        skyColor *= PowerHeuristic(bsdfPdf, environment->pdf(normalize(hitSky.dir))); // 天空采样也能采到这个方向
+    }
+    return skyColor * rr;
+}
+
+Trace::PathSettings Trace::PathSettings::Capture()
+{
+    PathSettings settings;
+    settings.lightSelection = static_cast<LightSelection>(SamplingSettings::lightSelection);
+    settings.nextEventEstimation = SamplingSettings::nextEventEstimation;
+    settings.skyImportanceSampling = EnvironmentMap::importanceSampling.load(std::memory_order_relaxed);
+    settings.bounceLimit = Trace::bounceLimit;
+    settings.radianceCacheBounce = SamplingSettings::radianceCacheBounce;
+    settings.guidingBsdfFraction = SamplingSettings::guidingBsdfFraction;
+    settings.russianRoulette = SamplingSettings::russianRoulette;
+    settings.rouletteMinDepth = SamplingSettings::rouletteMinDepth;
+    return settings;
+}
+
+color4 Trace::CastRay(const Ray &ray, int traceDepth, const sd::DataStorage &dataStorage)
+{
+    return CastRay(ray, traceDepth, dataStorage, PathOptions());
 }
 
-color4 Trace::CastRay(const Ray &ray, int traceDepth, sd::DataStorage &dataStorage)
+color4 Trace::CastRay(const Ray &ray, int traceDepth, const sd::DataStorage &dataStorage, const PathOptions &options)
 {
+    const PathSettings &settings = options.settings;
+    const LightSelection selection = settings.lightSelection;
     vec4 color = vec4(0.0f);
     vec3 throughout = vec3(1.f);
     Ray tracingRay = ray;
-    while (traceDepth < bounceLimit)
+    const bool nee = settings.nextEventEstimation && !dataStorage.emitters.empty();
+    float bsdfPdf = 0.0f; // 上一次弹射方向的 BSDF 概率密度, 0 表示光源采样无法覆盖(相机光线或镜面)
+    sd::HitInfos lastHit;  // 上一次弹射所在的着色点, light BVH 的选择概率与之有关
+    const EnvironmentMap *environment = EnvironmentMap::Current();
+    const bool sampleSky = environment && settings.skyImportanceSampling;
+    auto occluded = [&dataStorage](const Ray &shadowRay)
+    { return sd::BVH::IntersectAny(dataStorage, shadowRay, std::numeric_limits<float>::infinity()); };
+    const vec3 *primaryDirect = options.primaryDirect;
+    bool directCovered = false; // 上一个着色点的直接光照已全部由 primaryDirect 计入
+    // 经过的漫反射点: 路径结束后由 (最终颜色 - 到达该点时的颜色) / 该点的吞吐量 得到其出射辐射亮度的估计
+    struct CacheVertex
+    {
+        uint64_t key;
+        vec3 throughout;
+        vec3 color;
+    };
+    RadianceCache *radianceCache = options.radianceCache;
+    CacheVertex cacheVertices[kMaxCacheVertices];
+    int cacheVertexCount = 0;
+    int diffuseVertices = 0;
+    const bool cacheTraining = radianceCache && Random::UniformFloat() < kCacheTrainingFraction;
+    const vec3 cameraPos = ray.getOrigin();
+    // 引导训练: 路径结束后由 (最终引导颜色 - 弹射前的引导颜色) / 弹射后的吞吐量 得到沿弹射方向的入射辐射亮度
+    // 引导颜色只累计 BSDF 采样命中的光源与天空且不加 MIS 权重, 不含光源采样与 primaryDirect,
+    // 否则已由光源采样覆盖的直接光照在记录中被压低, 引导分布会低估光源方向
+    struct GuidingVertex
+    {
+        vec3 pos;
+        vec3 wi;
+        vec3 throughout;
+        vec3 color;
+        float pdf;
+    };
+    PathGuiding::SDTree *guiding = options.guiding;
+    GuidingVertex guidingVertices[kMaxGuidingVertices];
+    int guidingVertexCount = 0;
+    const bool guidingTraining = guiding && guiding->training();
+    vec3 guidingColor(0.0f);
+    const int startDepth = traceDepth;
+    Profiler::PathEnd pathEnd = Profiler::PathEnd::BounceLimit;
+    while (static_cast<size_t>(traceDepth) < settings.bounceLimit)
     {
 
+        Random::SeedBounce(traceDepth);
         traceDepth++;
         // 场景测试
         sd::HitInfos closestHit;
@@ -77,20 +270,142 @@ color4 Trace::CastRay(const Ray &ray, int traceDepth, sd::DataStorage &dataStora
             // tracingRay = Ray(closestHit.pos + bias, rndDir);
             // throughout *= vec3(0.9f, 0.4f, 0.7f);
             // color = vec4(1.0f,0.0f,0.0f,0.0f);
-            if(closestHit.matFlags == sd::LambertianMat)
-            throughout *= vec3(Lambertian::Hit(closestHit, tracingRay, color4(0.9f, 0.6f, 0.5f, 1.0f)));
+            if (closestHit.matFlags == sd::LightEmitMat)
+            {
+                // 命中光源结束路径, 已被光源采样覆盖的部分按 MIS 权重计入
+                float weight = directCovered ? 0.0f : 1.0f;
+                if (!directCovered && nee && bsdfPdf > 0.0f)
+                {
+                    float cosLight = std::abs(glm::dot(closestHit.normal, normalize(tracingRay.getDirection())));
+                    float pdfArea = EmitterPdfArea(dataStorage, selection, lastHit, closestHit.triangleIndex);
+                    weight = PowerHeuristic(bsdfPdf, LightPdf(pdfArea, closestHit.t * glm::length(tracingRay.getDirection()), cosLight));
+                }
+                vec3 emission = dataStorage.triangleStorage.triangles[closestHit.triangleIndex].emission;
+                color += color4(throughout * emission * weight, 1.0f);
+                guidingColor += throughout * emission;
+                pathEnd = Profiler::PathEnd::Emitter;
+                break;
+            }
+            const auto &triangle = dataStorage.triangleStorage.triangles[closestHit.triangleIndex];
+            ShadingBsdf bsdf;
+            if (closestHit.matFlags == sd::LambertianMat)
+            {
+                bsdf = ShadingBsdf::Diffuse(closestHit.normal, triangle.albedo);
+            }
+            else if (closestHit.matFlags == sd::MetalMat)
+            {
+                bsdf = ShadingBsdf::Glossy(closestHit.normal, -normalize(tracingRay.getDirection()), triangle.albedo, triangle.roughness);
+            }
+            else
+            {
+                // 没有可采样的 BSDF, 光线不会前进, 结束路径而不是重复追踪同一条光线
+                pathEnd = Profiler::PathEnd::Absorbed;
+                break;
+            }
+            if (radianceCache && bsdf.type == ShadingBsdf::Type::Diffuse)
+            {
+                // 缓存值已包含这一点的直接光照与之后的全部弹射
+                uint64_t key = radianceCache->key(closestHit.pos, closestHit.normal, cameraPos);
+                vec3 cached;
+                if (!cacheTraining && diffuseVertices >= settings.radianceCacheBounce && radianceCache->query(key, cached))
+                {
+                    color += color4(throughout * cached, 1.0f);
+                    guidingColor += throughout * cached;
+                    pathEnd = Profiler::PathEnd::Cache;
+                    break;
+                }
+                if (cacheVertexCount < kMaxCacheVertices)
+                {
+                    cacheVertices[cacheVertexCount++] = {key, throughout, vec3(color)};
+                }
+                ++diffuseVertices;
+            }
+            // 镜面只能靠 BSDF 采样命中光源, 光源采样的权重为 0, 直接跳过
+            directCovered = primaryDirect && !lastHit.hit && !bsdf.isSpecular(); // 只用于主光线命中点
+            if (directCovered)
+            {
+                color += color4(throughout * *primaryDirect, 0.0f);
+            }
+            const bool diffuse = bsdf.type == ShadingBsdf::Type::Diffuse;
+            const PathGuiding::DTree *guide = guiding && diffuse ? guiding->distribution(closestHit.pos) : nullptr;
+            // 引导时光源与天空采样的 MIS 权重也使用混合后的概率密度
+            auto scatter = [&](const auto &sampler, vec3 &wi)
+            {
+                if (!directCovered && !sampler.isSpecular())
+                {
+                    if (nee)
+                    {
+                        color += color4(throughout * SampleEmitters(dataStorage, selection, closestHit, sampler), 0.0f);
+                    }
+                    if (sampleSky)
+                    {
+                        color += color4(throughout * SampleSky(*environment, closestHit.pos, sampler, occluded), 0.0f);
+                    }
+                }
+                return sampler.sample(wi, bsdfPdf);
+            };
+            vec3 wi;
+            vec3 weight = guide ? scatter(PathGuiding::GuidedBsdf(bsdf, *guide, settings.guidingBsdfFraction), wi)
+                                : scatter(bsdf, wi);
+            if (weight == vec3(0.0f))
+            {
+                pathEnd = Profiler::PathEnd::Absorbed;
+                break;
+            }
+            if (guidingTraining && diffuse && guidingVertexCount < kMaxGuidingVertices)
+            {
+                guidingVertices[guidingVertexCount++] = {closestHit.pos, wi, throughout * weight, guidingColor, bsdfPdf};
+            }
+            throughout *= weight;
+            // 吞吐量的最大分量低于 1 后以它为存活概率, 存活的路径除以该概率, 期望不变
+            if (settings.russianRoulette && traceDepth >= settings.rouletteMinDepth)
+            {
+                float survival = glm::max(glm::max(throughout.r, throughout.g), throughout.b);
+                if (survival < 1.0f)
+                {
+                    float rr = Random::RussianRoulette(survival);
+                    if (rr == 0.0f)
+                    {
+                        pathEnd = Profiler::PathEnd::Roulette;
+                        break;
+                    }
+                    throughout *= rr;
+                }
+            }
+            tracingRay = Ray(closestHit.pos + closestHit.normal * 1e-5f, wi); // 防止自相交
+            lastHit = closestHit;
             continue;
         }
         // 未命中
         // color.rgb += throughout * hitSky(tracingRay.ori, tracingRay.dir).rgb;
-        vec3 unit_direction = normalize(tracingRay.getDirection());
-        auto a = 0.5f * (unit_direction.y + 1.0f);
-
-        vec3 skyColor = (1.0f - a) * vec3(1.0f, 1.0f, 1.0f) + a * vec3(0.5f, 0.7f, 1.0f) / 1.f;
+        vec3 skyRadiance = directCovered && !guidingTraining ? vec3(0.0f) : Sky::Radiance(environment, tracingRay.getDirection());
+        vec3 skyColor = directCovered ? vec3(0.0f) : skyRadiance;
+        if (!directCovered && sampleSky && bsdfPdf > 0.0f)
+        {
+            skyColor *= PowerHeuristic(bsdfPdf, environment->pdf(normalize(tracingRay.getDirection())));
+        }
         color += color4(throughout * skyColor, 1.0f);
-
+        guidingColor += throughout * skyRadiance;
+        pathEnd = Profiler::PathEnd::Sky;
         break;
     }
+    Profiler::RecordPath(traceDepth - startDepth, pathEnd);
+    for (int i = 0; i < cacheVertexCount; ++i)
+    {
+        const CacheVertex &vertex = cacheVertices[i];
+        if (glm::min(glm::min(vertex.throughout.r, vertex.throughout.g), vertex.throughout.b) > 1e-6f)
+        {
+            radianceCache->accumulate(vertex.key, (vec3(color) - vertex.color) / vertex.throughout);
+        }
+    }
+    for (int i = 0; i < guidingVertexCount; ++i)
+    {
+        const GuidingVertex &vertex = guidingVertices[i];
+        if (glm::min(glm::min(vertex.throughout.r, vertex.throughout.g), vertex.throughout.b) > 1e-6f && vertex.pdf > 0.0f)
+        {
+            guiding->record(vertex.pos, vertex.wi, Luminance((guidingColor - vertex.color) / vertex.throughout) / vertex.pdf);
+        }
+    }
 
     return color;
 }
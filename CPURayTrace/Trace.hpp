@@ -11,13 +11,61 @@ namespace SimplifiedData
 {
     struct DataStorage;
 }
+class EnvironmentMap;
+class RadianceCache;
+struct ShadingBsdf;
+namespace PathGuiding
+{
+    class SDTree;
+}
 namespace Trace
 {
     inline size_t bounceLimit = 4;
 
+    // 次事件估计选择发光三角形的方式
+    enum class LightSelection
+    {
+        Area, // 按面积, 与着色点无关
+        Tree  // 按 light BVH 估计的贡献
+    };
+
     color4 CastRayDirectionLight(const Ray &ray, const color4 &light, const Scene &scene);
 
-    color4 CastRay(const Ray &ray, int traceDepth, const Scene &scene);
+    // bsdfPdf: 产生这条光线的 BSDF 采样的概率密度, 未命中时据此与天空采样做 MIS; 0 表示不加权
+    color4 CastRay(const Ray &ray, int traceDepth, const Scene &scene, float bsdfPdf = 0.0f);
+    // 在着色点按天空亮度采样一个方向, 返回 MIS 加权后的 f * cos * Le / pdf
+    vec3 SampleEnvironment(const EnvironmentMap &environment, const vec3 &pos, const ShadingBsdf &bsdf, const Scene &scene);
+
+    // sd 路径的采样设置; 后台追踪时由主线程每遍拷贝一份(Capture), 着色线程不直接读 UI 修改的全局变量
+    struct PathSettings
+    {
+        LightSelection lightSelection = LightSelection::Tree;
+        bool nextEventEstimation = true;
+        bool skyImportanceSampling = true;
+        size_t bounceLimit = 4;
+        int radianceCacheBounce = 1;      // 第几次漫反射弹射之后查询辐射缓存
+        float guidingBsdfFraction = 0.5f; // 引导时按 BSDF 采样的比例
+        bool russianRoulette = true;
+        int rouletteMinDepth = 3;
+
+        // 读取当前 UI 设置, 只能在主线程调用
+        static PathSettings Capture();
+    };
+
+    // 使用默认的 PathSettings
+    color4 CastRay(const Ray &ray, int traceDepth, const SimplifiedData::DataStorage &dataStorage);
+    // sd 路径的设置与可选扩展, 扩展都为空时按 NEE 与 MIS 估计
+    struct PathOptions
+    {
+        PathSettings settings;
+        // 主光线命中点的直接光照已由外部估计(ReSTIR)时传入, 该点不再采样光源与天空,
+        // 下一次弹射直接命中光源或天空也不再计入
+        const vec3 *primaryDirect = nullptr;
+        // 漫反射点向缓存累计出射辐射亮度, 第 settings.radianceCacheBounce 次漫反射弹射后命中缓存时结束路径
+        RadianceCache *radianceCache = nullptr;
+        // 漫反射点按学习到的入射辐射亮度分布与 BSDF 混合采样弹射方向; 训练期间路径结束后把各点的入射估计记入
+        PathGuiding::SDTree *guiding = nullptr;
+    };
 
-    color4 CastRay(const Ray &ray, int traceDepth, SimplifiedData::DataStorage &dataStorage);
+    color4 CastRay(const Ray &ray, int traceDepth, const SimplifiedData::DataStorage &dataStorage, const PathOptions &options);
 }
@@ -20,6 +20,11 @@ uniform sampler2D lastSample;
 uniform float rand;
 uniform int samplesCount;
 
+// 蓝噪声遮罩, 每帧按 blueNoiseOffset 环形平移, 用于第一次弹射的方向
+uniform sampler2D blueNoiseTex;
+uniform vec2 blueNoiseOffset;
+uniform int useBlueNoise;
+
 /*****************视口大小******************************************************************/
 uniform int width;
 uniform int height;
@@ -179,11 +184,18 @@ float random(vec2 st)
     return fract(sin(dot(st.xy, vec2(12.9898, 78.233))) * 43758.5453123);
 }
 
-vec3 sampleCosineHemisphere(vec3 normal, vec2 seed)
+vec2 blueNoise()
+{
+    ivec2 p = ivec2(mod(gl_FragCoord.xy + blueNoiseOffset, vec2(textureSize(blueNoiseTex, 0))));
+    return texelFetch(blueNoiseTex, p, 0).rg;
+}
+
+// xi 为 [0,1)^2 上的均匀随机数
+vec3 sampleCosineHemisphereUV(vec3 normal, vec2 xi)
 {
     // 1. 在一个单位圆盘内生成均匀随机点
-    float r1 = 2.0 * PI * random(seed);
-    float r2 = random(seed + vec2(1.0, 0.0));
+    float r1 = 2.0 * PI * xi.x;
+    float r2 = xi.y;
     float r = sqrt(r2);
 
     float x = r * cos(r1);
@@ -201,6 +213,11 @@ vec3 sampleCosineHemisphere(vec3 normal, vec2 seed)
     return normalize(u * x + v * y + w * z);
 }
 
+vec3 sampleCosineHemisphere(vec3 normal, vec2 seed)
+{
+    return sampleCosineHemisphereUV(normal, vec2(random(seed), random(seed + vec2(1.0, 0.0))));
+}
+
 vec3 RayAt(in Ray ray, in float t)
 {
     return ray.ori + t * ray.dir;
@@ -285,7 +302,9 @@ vec4 castRay(in Ray ray, int traceDepth,uint rootIndex)
         {
             // color+= lambertianIrradiance(closestHit);
             throughout *= vec3(1.0f);
-            vec3 rndDir = sampleCosineHemisphere(closestHit.normal, TexCoord * (rand + 1.f));
+            vec3 rndDir = (useBlueNoise != 0 && traceDepth == 1)
+                              ? sampleCosineHemisphereUV(closestHit.normal, blueNoise())
+                              : sampleCosineHemisphere(closestHit.normal, TexCoord * (rand + 1.f));
             vec3 bias = closestHit.normal*1e-4;
             // tracingRay = Ray(closestHit.pos+bias, rndDir/2.f+closestHit.normal*1.f);
             tracingRay = Ray(closestHit.pos+bias, rndDir);
@@ -1,5 +1,50 @@
 #include "Texture.hpp"
 
+/// @brief 估算纹理显存占用, 驱动的实际分配可能有额外对齐
+static size_t EstimateTextureBytes(GLenum internalFormat, size_t texels, bool mipmapping)
+{
+    size_t bytesPerTexel = 4;
+    switch (internalFormat)
+    {
+    case GL_RGBA32F:
+        bytesPerTexel = 16;
+        break;
+    case GL_RGB32F:
+        bytesPerTexel = 12;
+        break;
+    case GL_RGBA16F:
+    case GL_RG32F:
+        bytesPerTexel = 8;
+        break;
+    case GL_RGB16F:
+        bytesPerTexel = 6;
+        break;
+    case GL_RGB:
+    case GL_RGB8:
+        bytesPerTexel = 3;
+        break;
+    case GL_RG16F:
+    case GL_R32F:
+    case GL_RGBA:
+    case GL_RGBA8:
+    case GL_DEPTH_COMPONENT:
+    case GL_DEPTH_COMPONENT32F:
+        bytesPerTexel = 4;
+        break;
+    case GL_R16F:
+        bytesPerTexel = 2;
+        break;
+    case GL_RED:
+    case GL_R8:
+        bytesPerTexel = 1;
+        break;
+    default:
+        break;
+    }
+    size_t bytes = texels * bytesPerTexel;
+    return mipmapping ? bytes * 4 / 3 : bytes;
+}
+
 Texture2D::Texture2D()
 {
     ID = 0;
@@ -55,6 +100,8 @@ void Texture2D::generate(unsigned int width, unsigned int height, GLenum interna
             glGenerateMipmap(Target);
     }
     glBindTexture(Target, 0);
+    size_t bytes = EstimateTextureBytes(InternalFormat, size_t(Width) * Height, Mipmapping);
+    memoryTracker.set(bytes, bytes);
 }
 
 void Texture2D::generateComputeStorage(unsigned int width, unsigned int height, GLenum internalFormat)
@@ -79,6 +126,8 @@ void Texture2D::generateComputeStorage(unsigned int width, unsigned int height,
         glTexParameteri(Target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     }
     glBindTexture(Target, 0);
+    size_t bytes = EstimateTextureBytes(InternalFormat, size_t(Width) * Height, false);
+    memoryTracker.set(bytes, bytes);
 }
 
 /// @brief 设置纹理数据 在Generate()之后调用 通常是逐帧调用
@@ -130,6 +179,7 @@ void Texture2D::swap(Texture2D &other)
     std::swap(Mipmapping, other.Mipmapping);
     std::swap(Width, other.Width);
     std::swap(Height, other.Height);
+    std::swap(memoryTracker, other.memoryTracker);
 }
 
 /**
@@ -186,6 +236,8 @@ void Texture2D::resize(int ResizeWidth, int ResizeHeight)
             glGenerateMipmap(Target);
     }
     glBindTexture(Target, 0);
+    size_t bytes = EstimateTextureBytes(InternalFormat, size_t(Width) * Height, Mipmapping);
+    memoryTracker.set(bytes, bytes);
 }
 
 void Texture2D::resizeComputeStorage(int ResizeWidth, int ResizeHeight)
@@ -257,6 +309,8 @@ void TextureCube::generate(unsigned int width, unsigned int height, GLenum inter
     }
     if (mipmap)
         glGenerateMipmap(Target);
+    size_t bytes = EstimateTextureBytes(InternalFormat, size_t(Width) * Height * 6, Mipmapping);
+    memoryTracker.set(bytes, bytes);
 }
 
 void TextureCube::setFaceData(FaceEnum faceTarget, void *data)
@@ -298,6 +352,8 @@ void TextureCube::resize(int ResizeWidth, int ResizeHeight)
         glGenerateMipmap(Target);
 
     glBindTexture(Target, 0);
+    size_t bytes = EstimateTextureBytes(InternalFormat, size_t(Width) * Height * 6, Mipmapping);
+    memoryTracker.set(bytes, bytes);
 }
 void TextureCube::setWrapMode(GLenum wrapMode)
 {
@@ -376,6 +432,8 @@ void Texture2DArray::generate(unsigned int width, unsigned int height, unsigned
             glGenerateMipmap(Target);
     }
     glBindTexture(Target, 0);
+    size_t bytes = EstimateTextureBytes(InternalFormat, size_t(Width) * Height * Depth, Mipmapping);
+    memoryTracker.set(bytes, bytes);
 }
 
 /// @brief 设置纹理数组指定层数据 在Generate()之后调用
@@ -426,6 +484,8 @@ void Texture2DArray::resize(int ResizeWidth, int ResizeHeight)
             glGenerateMipmap(Target);
     }
     glBindTexture(Target, 0);
+    size_t bytes = EstimateTextureBytes(InternalFormat, size_t(Width) * Height * Depth, Mipmapping);
+    memoryTracker.set(bytes, bytes);
 }
 
 /**
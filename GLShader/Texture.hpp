@@ -12,6 +12,7 @@
 #include <cassert>
 
 #include "GLResource.hpp"
+#include "MemoryRegistry.hpp"
 
 using TextureID = unsigned int;
 /// @brief 管理GL Texture资源
@@ -32,6 +33,8 @@ public:
     unsigned int Width;  // 纹理的宽度（以像素为单位）
     unsigned int Height; // 纹理的高度（以像素为单位）
 
+    MemoryRegistry::Tracker memoryTracker{MemoryRegistry::Category::GLTexture}; // 显存估算
+
     Texture2D();
     Texture2D(Texture2D &&) noexcept = default;
     Texture2D &operator=(Texture2D &&) noexcept = default;
@@ -115,6 +118,8 @@ public:
     unsigned int Width;  // 正方形纹理的宽度（以像素为单位）
     unsigned int Height; // 正方形纹理的高度（以像素为单位）
 
+    MemoryRegistry::Tracker memoryTracker{MemoryRegistry::Category::GLTexture}; // 显存估算
+
     TextureCube();
     TextureCube(TextureCube &&) noexcept = default;
     TextureCube &operator=(TextureCube &&) noexcept = default;
@@ -152,6 +157,8 @@ public:
     unsigned int Height; // 纹理的高度（以像素为单位）
     unsigned int Depth;  // 纹理层数
 
+    MemoryRegistry::Tracker memoryTracker{MemoryRegistry::Category::GLTexture}; // 显存估算
+
     Texture2DArray();
     Texture2DArray(Texture2DArray &&) noexcept = default;
     Texture2DArray &operator=(Texture2DArray &&) noexcept = default;
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+class Camera;
+
+// 手动触发的性能基准, 结果显示在 Benchmarks 窗口
+// 基准在后台线程运行, 不阻塞UI
+namespace Benchmark
+{
+    // 场景访问的锁竞争: 每像素 shared_lock / 每像素 pin 快照 / 每块 pin / 每帧 pin
+    // 吞吐量单位: 百万像素每秒
+    struct ContentionResult
+    {
+        int threads = 0;
+        double perPixelLock = 0.0;
+        double perPixelPin = 0.0;
+        double perTilePin = 0.0;
+        double perFramePin = 0.0;
+    };
+
+    std::vector<ContentionResult> RunSceneLockContention(const std::vector<int> &threadCounts, size_t pixelsPerThread);
+
+    // 线程扩展性: 以不同线程数在独立线程池上对当前场景快照求交主光线
+    // 吞吐量单位: 百万光线每秒, 加速比与效率相对第一个线程数
+    struct ScalingResult
+    {
+        int threads = 0;
+        double raysPerSecond = 0.0;
+        double speedup = 0.0;
+        double efficiency = 0.0;
+    };
+
+    std::vector<ScalingResult> RunThreadScaling(const Camera &cam, const std::vector<int> &threadCounts, bool pinThreads, bool useSMT, size_t raysPerRun);
+
+    // 等时间收敛: 每种采样器在相同的时间预算内逐遍累计当前视角的小图, 与高采样数的参考图比较 RMSE
+    struct SamplerResult
+    {
+        int sampler = 0; // Random::SamplerType
+        double budgetMs = 0.0;
+        int samplesPerPixel = 0;
+        double rmse = 0.0;
+    };
+
+    std::vector<SamplerResult> RunSamplerComparison(const Camera &cam, const std::vector<double> &budgetsMs, int referenceSamples);
+
+    // 多光源: 地面上方散布 lightCount 个小面光源(总功率不变), 以相同采样数比较按面积与按 light BVH 选择光源
+    // variance 为每像素单个采样亮度方差的平均
+    struct LightSelectionResult
+    {
+        int lights = 0;
+        int selection = 0; // Trace::LightSelection
+        int samplesPerPixel = 0;
+        double timeMs = 0.0;
+        double variance = 0.0;
+    };
+
+    std::vector<LightSelectionResult> RunLightSelection(const std::vector<int> &lightCounts, int samplesPerPixel);
+
+    void RenderUI(const Camera &cam);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// 平铺的蓝噪声遮罩
+// 启动后首次使用时以 void-and-cluster 生成两张独立的 64x64 遮罩(RG 两通道), 值为排名 (rank + 0.5) / 4096.
+// 低采样数时, 相邻像素的误差互相错开, 看起来是细腻的高频噪声而不是成团的白噪声.
+// 第 n 个采样把遮罩按 R2 序列环形平移, 每个像素在时间上仍然近似均匀分布.
+namespace BlueNoise
+{
+    inline constexpr uint32_t kSize = 64;
+
+    // RG 交错, kSize * kSize * 2 个值
+    const std::vector<float> &Mask();
+
+    // 第 sampleIndex 个采样的环形平移量(纹素)
+    inline void Offset(uint32_t sampleIndex, uint32_t &ox, uint32_t &oy)
+    {
+        double fx = 0.5 + 0.7548776662466927 * sampleIndex;
+        double fy = 0.5 + 0.5698402909980532 * sampleIndex;
+        ox = static_cast<uint32_t>((fx - std::floor(fx)) * kSize);
+        oy = static_cast<uint32_t>((fy - std::floor(fy)) * kSize);
+    }
+
+    inline float Sample(uint32_t x, uint32_t y, int channel)
+    {
+        return Mask()[((y % kSize) * kSize + (x % kSize)) * 2 + channel];
+    }
+}
@@ -37,13 +37,34 @@ public:
             uv.y * height - height / 2,
             focalLength));
         viewDir.x = -viewDir.x;
+        return getRotation() * viewDir;
+    }
+    // 相机空间到世界空间的旋转, 列为相机的 x, y, z 轴(z 指向观察点)
+    glm::mat3 getRotation() const
+    {
         vec3 absY = vec3(0.f, 1.f, 0.f);
         vec3 z = DirectionOf(lookAtCenter, position);
         vec3 x = glm::normalize(glm::cross(absY, z));
         vec3 y = glm::cross(z, x);
-        glm::mat3 rotation(x, y, z);
-
-        return rotation * viewDir;
+        return glm::mat3(x, y, z);
+    }
+    // getRayDirction 的逆: 世界空间方向对应的屏幕uv, 方向指向相机后方时返回 false
+    bool directionToUV(const vec3 &worldDir, vec2 &uv) const
+    {
+        vec3 local = glm::transpose(getRotation()) * worldDir;
+        if (local.z <= 1e-6f)
+        {
+            return false;
+        }
+        local *= focalLength / local.z;
+        uv.x = (width / 2 - local.x) / width;
+        uv.y = (local.y + height / 2) / height;
+        return true;
+    }
+    bool operator==(const Camera &other) const
+    {
+        return focalLength == other.focalLength && position == other.position && lookAtCenter == other.lookAtCenter &&
+               width == other.width && height == other.height;
     }
     void resize(int newWidth, int newHeight)
     {
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// CPU 追踪的天空环境光
+// 把 SkySettings 的大气散射天空(与 skyTex.fs 相同的单次散射模型)与太阳圆盘制成经纬度表,
+// 按 亮度 * sinθ 建立边缘/条件 CDF, 在漫反射点直接按天空亮度采样方向, 与 BSDF 采样按 MIS 合并.
+// 天空参数改变时在后台重建, 完成后发布并重置累计; 尚未建好时 Current() 返回空, 追踪退回渐变天空.
+class EnvironmentMap
+{
+public:
+    static constexpr int kWidth = 256; // φ ∈ [0, 2π)
+    static constexpr int kHeight = 128; // θ ∈ [0, π], θ 从 +Y 天顶量起
+    // 漫反射点是否显式采样天空; 旧版场景的材质在工作线程中直接读取, 因此为原子变量
+    inline static std::atomic<bool> importanceSampling = true;
+
+    // 决定天空的参数, 取自 SkySettings
+    struct Parameters
+    {
+        float skyHeight = 0.f;
+        float earthRadius = 0.f;
+        float skyIntensity = 0.f;
+        float HRayleigh = 0.f;
+        float HMie = 0.f;
+        float atmosphereDensity = 0.f;
+        float MieDensity = 0.f;
+        float gMie = 0.f;
+        float absorbMie = 0.f;
+        float MieIntensity = 0.f;
+        glm::vec3 betaMie = glm::vec3(0.f);
+        int maxStep = 0;
+        glm::vec3 sunDir = glm::vec3(0.f);
+        glm::vec3 sunColor = glm::vec3(0.f);
+
+        bool operator==(const Parameters &other) const = default;
+    };
+
+    static std::shared_ptr<const EnvironmentMap> Build(const Parameters &parameters);
+
+    // 主线程每帧调用: 天空参数改变时启动后台重建, 重建完成时发布
+    static void Update();
+    // 当前发布的天空, 每个线程缓存一份引用, 只在发布新表后重新获取; 可并发调用
+    static const EnvironmentMap *Current();
+    // 已发布的天空版本, 每次发布新表加一; 依赖天空的缓存据此判断是否失效
+    static uint64_t Generation();
+
+    // 方向所在纹素的辐射亮度
+    glm::vec3 lookup(const glm::vec3 &dir) const;
+    // 按亮度采样方向, pdf 为立体角概率密度; 天空全黑时 pdf 为 0
+    glm::vec3 sample(float u1, float u2, float &pdf) const;
+    // sample 采到 dir 的立体角概率密度
+    float pdf(const glm::vec3 &dir) const;
+
+private:
+    std::vector<glm::vec3> radiance;   // kWidth * kHeight, 行主序, 行为 θ
+    std::vector<float> conditionalCdf; // 每行 kWidth + 1 个
+    std::vector<float> rowIntegrals;   // 每行分布函数的均值
+    std::vector<float> marginalCdf;    // kHeight + 1 个
+    float marginalIntegral = 0.f;
+
+    inline float luminance(int x, int y) const
+    {
+        const glm::vec3 &c = radiance[y * kWidth + x];
+        return 0.2126f * c.r + 0.7152f * c.g + 0.0722f * c.b;
+    }
+    void buildDistribution();
+};
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// 内存统计
+// 每个子系统记录 reserved(已向系统/驱动申请的字节) 与 used(实际存放有效数据的字节).
+// 所有者通过 Tracker 上报自身用量, Tracker 析构时自动撤销, 因此统计值随对象生命周期变化, 可用于容量规划与查找泄漏.
+namespace MemoryRegistry
+{
+    enum class Category
+    {
+        TriangleStorage,
+        NodeStorage,
+        FlatTriangleStorage,
+        FlatNodeStorage,
+        LegacyScene,
+        CPUImage,
+        RadianceCache,
+        PathGuiding,
+        GLTexture,
+        Count
+    };
+
+    struct Usage
+    {
+        int64_t reserved = 0;
+        int64_t used = 0;
+    };
+
+    const char *CategoryName(Category category);
+
+    void AddReserved(Category category, int64_t bytes);
+    void AddUsed(Category category, int64_t bytes);
+    Usage GetUsage(Category category);
+    Usage GetTotalUsage();
+
+    // 机器可读的统计快照 (JSON)
+    std::string DumpJSON();
+    void DumpJSON(const std::string &path);
+
+    void RenderUI();
+
+    // 所有者持有的用量记录
+    // 拷贝得到的 Tracker 不继承计数: 拷贝出的对象(例如共享页面的场景快照)需要自行上报, 避免重复统计
+    class Tracker
+    {
+        Category category = Category::Count;
+        int64_t reserved = 0;
+        int64_t used = 0;
+
+    public:
+        Tracker() = default;
+        explicit Tracker(Category _category) : category(_category) {}
+        Tracker(const Tracker &other) : category(other.category) {}
+        Tracker &operator=(const Tracker &other)
+        {
+            if (this != &other && category != other.category)
+            {
+                set(0, 0);
+                category = other.category;
+            }
+            return *this;
+        }
+        Tracker(Tracker &&other) noexcept
+            : category(other.category), reserved(other.reserved), used(other.used)
+        {
+            other.reserved = 0;
+            other.used = 0;
+        }
+        Tracker &operator=(Tracker &&other) noexcept
+        {
+            if (this != &other)
+            {
+                set(0, 0);
+                category = other.category;
+                reserved = other.reserved;
+                used = other.used;
+                other.reserved = 0;
+                other.used = 0;
+            }
+            return *this;
+        }
+        ~Tracker()
+        {
+            set(0, 0);
+        }
+
+        inline void set(size_t _reserved, size_t _used)
+        {
+            if (category == Category::Count)
+            {
+                return;
+            }
+            AddReserved(category, static_cast<int64_t>(_reserved) - reserved);
+            AddUsed(category, static_cast<int64_t>(_used) - used);
+            reserved = static_cast<int64_t>(_reserved);
+            used = static_cast<int64_t>(_used);
+        }
+    };
+}
@@ -59,7 +59,7 @@ private:
                 indices.push_back(face.mIndices[j]);
         }
 
-        return Mesh(vertices, indices, std::move(Lambertian(color4(0.8f, 0.3f, 0.3f, 1.f)))); // 暂时不处理材质
+        return Mesh(vertices, indices, Lambertian(color4(0.8f, 0.3f, 0.3f, 1.f))); // 暂时不处理材质
     }
 
     /* [in]: loadedScene : Obj file imported in memory
@@ -88,7 +88,7 @@ private:
             auto&& meshes = PostProcess(*raw_model);
             for (auto&& mesh : meshes)
             {
-                scene.addObject(std::make_shared<Mesh>(mesh));
+                scene.addObject(std::make_shared<Mesh>(std::move(mesh)));
             }
         }
         catch (std::exception& e)
@@ -146,7 +146,7 @@ public:
             auto&& meshes = PostProcess(*raw_model);
             for (auto&& mesh : meshes)
             {
-                scene.addObject(std::make_shared<Mesh>(mesh));
+                scene.addObject(std::make_shared<Mesh>(std::move(mesh)));
             }
         }
         catch (std::exception& e)
@@ -1,24 +1,172 @@
 #pragma once
 
-#include <random>
+#include <cstdint>
 #include <glm/glm.hpp>
-#include <glm/gtc/random.hpp>
 #include <glm/gtc/constants.hpp>
 #include <vector>
+#include "Sobol.hpp"
+#include "BlueNoise.hpp"
 
 namespace Random
 {
-    inline std::uniform_real_distribution<float> randomFloats(0.0, 1.0); // random floats between [0.0, 1.0]
-    inline std::default_random_engine generator;
+    // PCG32 (XSH-RR), 64位状态, 32位输出; 状态只有16字节, 每个线程持有自己的一份
+    struct PCG32
+    {
+        uint64_t state = 0x853c49e6748fea9bULL;
+        uint64_t inc = 0xda3e39cb94b95bdbULL;
+
+        PCG32() = default;
+        PCG32(uint64_t seed, uint64_t sequence) { this->seed(seed, sequence); }
+
+        inline void seed(uint64_t seed, uint64_t sequence)
+        {
+            state = 0;
+            inc = (sequence << 1u) | 1u;
+            next();
+            state += seed;
+            next();
+        }
+        inline uint32_t next()
+        {
+            uint64_t old = state;
+            state = old * 6364136223846793005ULL + inc;
+            uint32_t xorshifted = static_cast<uint32_t>(((old >> 18u) ^ old) >> 27u);
+            uint32_t rot = static_cast<uint32_t>(old >> 59u);
+            return (xorshifted >> rot) | (xorshifted << ((~rot + 1u) & 31u));
+        }
+        // [0, 1) 均匀分布
+        inline float nextFloat()
+        {
+            return static_cast<float>(next() >> 8) * 0x1p-24f;
+        }
+    };
+
+    // splitmix64 的混合函数, 用于把 (像素, 采样序号, 弹射) 组合成互不相关的种子
+    inline uint64_t Hash64(uint64_t x)
+    {
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9ULL;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111ebULL;
+        x ^= x >> 31;
+        return x;
+    }
+
+    // 采样器
+    // Independent: 每个采样独立的 PCG32 随机数; Sobol: 同一像素的采样按累计序号取 Owen 扰乱的 Sobol 点
+    // 追踪每个采样前调用 SeedSample, 每次弹射前调用 SeedBounce, 结果只取决于像素, 采样序号与弹射深度, 与线程调度无关.
+    // 每个弹射(以及相机)是一组维度, 组内按 SampleDimension 取固定的维度, 其余随机数来自 UniformFloat
+    enum class SamplerType
+    {
+        Independent,
+        Sobol
+    };
+    inline SamplerType samplerType = SamplerType::Sobol;
+    // 相机组与第一次弹射的前两维使用蓝噪声遮罩, 低采样数时误差呈高频分布
+    // Independent: 遮罩按采样序号环形平移; Sobol: 全屏共用同一条扰乱序列, 每个像素按遮罩值做 Cranley-Patterson 旋转
+    inline bool blueNoise = true;
+    inline constexpr uint64_t kBlueNoiseGroups = 2;
+
+    enum SampleDimension : int
+    {
+        kDirectionU = 0, // 相机组: 像素内抖动; 弹射组: 反射方向. 前两维构成 (0,2)-序列
+        kDirectionV = 1,
+        kRoulette = 2,
+        kLightSelect = 3 // 按面积选择发光三角形
+    };
+
+    struct SamplerState
+    {
+        SamplerType type = SamplerType::Independent;
+        bool blueNoise = false;
+        uint32_t x = 0, y = 0;
+        uint64_t epochKey = 0;
+        uint64_t pixelKey = 0;
+        uint32_t sampleIndex = 0;
+        uint64_t group = 0;
+        uint32_t groupSeed = 0;  // 当前维度组的 Sobol 扰乱种子, 每个像素不同
+        uint32_t sharedSeed = 0; // 蓝噪声维度的扰乱种子, 全屏共用
+    };
+
+    // 当前线程的生成器与本次采样的状态
+    inline thread_local PCG32 threadGenerator;
+    inline thread_local SamplerState threadSampler;
+
+    inline void SeedGroup(uint64_t group)
+    {
+        uint64_t key = Hash64(threadSampler.pixelKey ^ Hash64(threadSampler.sampleIndex) ^ (group + 1));
+        threadGenerator.seed(key, group);
+        threadSampler.group = group;
+        threadSampler.groupSeed = static_cast<uint32_t>(Hash64(threadSampler.pixelKey ^ group));
+        // 蓝噪声维度的 Sobol 扰乱与像素无关, 像素间的差异只来自遮罩; 组内其余维度仍按像素扰乱, 否则全屏取到同一个值
+        threadSampler.sharedSeed = static_cast<uint32_t>(Hash64(threadSampler.epochKey ^ group));
+    }
+    // Sobol 的序号必须是该像素的累计采样序号, epoch 改变时换一组扰乱
+    // type 与 useBlueNoise 由调用方传入: 后台追踪使用每遍开始时拷贝的设置, 不读 UI 修改的 samplerType/blueNoise
+    inline void SeedSample(uint32_t x, uint32_t y, uint64_t sampleIndex, uint64_t epoch, SamplerType type, bool useBlueNoise)
+    {
+        threadSampler.type = type;
+        threadSampler.blueNoise = useBlueNoise;
+        threadSampler.x = x;
+        threadSampler.y = y;
+        threadSampler.epochKey = Hash64(epoch);
+        threadSampler.pixelKey = Hash64(threadSampler.epochKey ^ ((static_cast<uint64_t>(y) << 32) | x));
+        threadSampler.sampleIndex = static_cast<uint32_t>(sampleIndex);
+        SeedGroup(0);
+    }
+    inline void SeedBounce(int bounce)
+    {
+        SeedGroup(static_cast<uint64_t>(bounce) + 1);
+    }
+
+    inline float UniformFloat()
+    {
+        return threadGenerator.nextFloat();
+    }
+    // 当前维度组的第 dimension 维, [0, 1)
+    inline float Sample1D(int dimension)
+    {
+        const auto &state = threadSampler;
+        if (state.blueNoise && state.group < kBlueNoiseGroups && dimension <= kDirectionV)
+        {
+            // 各组使用遮罩的不同位置, 避免像素抖动与弹射方向相关
+            const uint32_t groupShift = static_cast<uint32_t>(state.group) * 37;
+            if (state.type == SamplerType::Sobol)
+            {
+                float shift = BlueNoise::Sample(state.x + groupShift, state.y + groupShift, dimension);
+                float value = Sobol::OwenScrambled(state.sampleIndex, dimension, state.sharedSeed) + shift;
+                return value < 1.0f ? value : value - 1.0f;
+            }
+            uint32_t ox, oy;
+            BlueNoise::Offset(state.sampleIndex, ox, oy);
+            return BlueNoise::Sample(state.x + ox + groupShift, state.y + oy + groupShift, dimension);
+        }
+        if (state.type == SamplerType::Sobol && dimension < Sobol::kDimensions)
+        {
+            return Sobol::OwenScrambled(state.sampleIndex, dimension, state.groupSeed);
+        }
+        return threadGenerator.nextFloat();
+    }
+    inline glm::vec2 Sample2D()
+    {
+        float u = Sample1D(kDirectionU);
+        float v = Sample1D(kDirectionV);
+        return glm::vec2(u, v);
+    }
+
     inline glm::vec3 RandomVector(float strength)
     {
-        return glm::linearRand(glm::vec3(-strength), glm::vec3(strength));
+        float x = UniformFloat();
+        float y = UniformFloat();
+        float z = UniformFloat();
+        return (glm::vec3(x, y, z) * 2.0f - 1.0f) * strength;
     }
     inline glm::vec3 GenerateSemiSphereVector(glm::vec3 normal)
     {
         // Generate a random vector in the full sphere
-        float u1 = static_cast<float>(rand()) / static_cast<float>(RAND_MAX);
-        float u2 = static_cast<float>(rand()) / static_cast<float>(RAND_MAX);
+        glm::vec2 u = Sample2D();
+        float u1 = u.x;
+        float u2 = u.y;
 
         float theta = 2.0f * glm::pi<float>() * u1;
         float phi = glm::acos(2.0f * u2 - 1.0f);
@@ -40,10 +188,9 @@ namespace Random
 
     inline glm::vec3 GenerateCosineSemiSphereVector(const glm::vec3 &normal)
     {
-        std::uniform_real_distribution<float> dist(0.0f, 1.0f);
-
-        float u1 = dist(generator);
-        float u2 = dist(generator);
+        glm::vec2 u = Sample2D();
+        float u1 = u.x;
+        float u2 = u.y;
 
         // 将均匀分布的随机数映射到圆盘上
         float r = glm::sqrt(u1);
@@ -73,7 +220,6 @@ namespace Random
 
     inline float RussianRoulette(float p)
     {
-        std::uniform_real_distribution<float> dist(0.0f, 1.0f);
-        return dist(generator) < p ? 1.0f / p : 0.0f;
+        return Sample1D(kRoulette) < p ? 1.0f / p : 0.0f;
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+// Owen 扰乱的 Sobol 序列 (Burley 2020, "Practical Hash-based Owen Scrambling")
+// 只使用前 4 维, 更多维度通过给每组 4 维换一个种子打乱样本序号来扩展(padding), 组间不相关.
+// 同一像素前 2^k 个样本在每组的前两维上构成分层的 (0,2)-序列, 收敛快于独立随机数.
+namespace Sobol
+{
+    inline constexpr int kDimensions = 4;
+
+    // Joe-Kuo 方向数, 第 0 维为 van der Corput
+    inline constexpr std::array<std::array<uint32_t, 32>, kDimensions> BuildDirections()
+    {
+        struct Polynomial
+        {
+            uint32_t s, a;
+            uint32_t m[3];
+        };
+        constexpr Polynomial polynomials[kDimensions - 1] = {{1, 0, {1, 0, 0}}, {2, 1, {1, 3, 0}}, {3, 1, {1, 3, 1}}};
+        std::array<std::array<uint32_t, 32>, kDimensions> directions{};
+        for (uint32_t i = 0; i < 32; ++i)
+        {
+            directions[0][i] = 1u << (31 - i);
+        }
+        for (int d = 1; d < kDimensions; ++d)
+        {
+            const Polynomial &p = polynomials[d - 1];
+            auto &v = directions[d];
+            for (uint32_t i = 0; i < p.s; ++i)
+            {
+                v[i] = p.m[i] << (31 - i);
+            }
+            for (uint32_t i = p.s; i < 32; ++i)
+            {
+                v[i] = v[i - p.s] ^ (v[i - p.s] >> p.s);
+                for (uint32_t k = 1; k < p.s; ++k)
+                {
+                    v[i] ^= ((p.a >> (p.s - 1 - k)) & 1u) * v[i - k];
+                }
+            }
+        }
+        return directions;
+    }
+    inline constexpr auto Directions = BuildDirections();
+
+    inline uint32_t ReverseBits(uint32_t x)
+    {
+        x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+        x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+        x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+        x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+        return (x >> 16) | (x << 16);
+    }
+
+    // 每一位只受更低位影响的哈希置换, 在位反转后的值上使用即等价于 Owen 扰乱
+    inline uint32_t LaineKarrasPermutation(uint32_t x, uint32_t seed)
+    {
+        x += seed;
+        x ^= x * 0x6c50b47cu;
+        x ^= x * 0xb82f1e52u;
+        x ^= x * 0xc7afe638u;
+        x ^= x * 0x8d22f6e6u;
+        return x;
+    }
+
+    inline uint32_t NestedUniformScramble(uint32_t x, uint32_t seed)
+    {
+        return ReverseBits(LaineKarrasPermutation(ReverseBits(x), seed));
+    }
+
+    inline uint32_t HashCombine(uint32_t seed, uint32_t v)
+    {
+        return seed ^ (v + (seed << 6) + (seed >> 2));
+    }
+
+    inline uint32_t Sample(uint32_t index, int dimension)
+    {
+        uint32_t result = 0;
+        const auto &v = Directions[dimension];
+        for (int bit = 0; index != 0; index >>= 1, ++bit)
+        {
+            if (index & 1u)
+            {
+                result ^= v[bit];
+            }
+        }
+        return result;
+    }
+
+    // 第 index 个样本的第 dimension 维, [0, 1); seed 区分像素与维度组
+    inline float OwenScrambled(uint32_t index, int dimension, uint32_t seed)
+    {
+        uint32_t shuffled = NestedUniformScramble(index, seed);
+        uint32_t value = NestedUniformScramble(Sample(shuffled, dimension), HashCombine(seed, static_cast<uint32_t>(dimension)));
+        return static_cast<float>(value >> 8) * 0x1p-24f;
+    }
+}
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// 常驻工作线程池
+// 每个工作线程持有自己的任务双端队列: 本线程从队尾取(LIFO, 缓存友好), 空闲线程从其他队列的队首窃取(FIFO).
+// 工作线程内提交的任务进入本线程队列, 外部线程提交的任务轮流分配到各个队列.
+// 渲染(每帧着色), 加载与BVH构建共用 Global() 实例, 避免每帧创建/销毁线程.
+// 线程数在构造时固定, 运行时通过 configure() 调整参与工作的线程数(其余线程休眠), 以及是否绑定到核心.
+class ThreadPool
+{
+public:
+    using Task = std::function<void()>;
+
+    struct Config
+    {
+        size_t threadCount = 0;  // 0 表示按 SMT 策略使用全部可用核心
+        bool pinThreads = false; // 第 i 个工作线程绑定到 LogicalProcessors 中的第 i 个
+        bool useSMT = true;      // 关闭时每个物理核心只使用一个逻辑处理器
+    };
+
+    // threadCount 为 0 时每个可用的逻辑处理器一个线程
+    explicit ThreadPool(size_t threadCount = 0);
+    explicit ThreadPool(const Config &config);
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+    ~ThreadPool();
+
+    static ThreadPool &Global();
+
+    // 可用的逻辑处理器编号, 先列出每个物理核心的第一个逻辑处理器, 再列出其余的 SMT 兄弟线程
+    // useSMT 为 false 时只返回前者; 拓扑不可用时按编号返回 hardware_concurrency 个
+    static const std::vector<int> &LogicalProcessors(bool useSMT);
+
+    inline size_t size() const { return workers.size(); }
+    // 参与工作的线程数, 按此数量划分任务
+    inline size_t concurrency() const { return activeWorkers.load(std::memory_order_relaxed); }
+    inline const Config &config() const { return currentConfig; }
+
+    // 调整参与工作的线程数(不超过 size())与绑核策略, 可在任务执行期间调用
+    void configure(const Config &config);
+
+    // 提交单个任务, 通过 future 取得结果或异常
+    template <typename F>
+    auto submit(F &&func) -> std::future<std::invoke_result_t<std::decay_t<F>>>
+    {
+        using Result = std::invoke_result_t<std::decay_t<F>>;
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(func));
+        auto future = task->get_future();
+        push([task]()
+             { (*task)(); });
+        return future;
+    }
+
+    // 取出并执行一个任务(本线程队列优先, 否则窃取), 没有可执行任务时返回 false
+    // 供等待方"边等边干", 工作线程内部等待子任务也不会死锁
+    bool tryRunOne();
+
+    void push(Task task);
+
+private:
+    struct WorkerQueue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    bool popLocal(size_t index, Task &task);
+    bool steal(size_t thief, Task &task);
+    void workerLoop(size_t index);
+    void applyAffinity();
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::vector<std::thread> workers;
+    std::mutex configMutex;
+    Config currentConfig;
+    std::atomic<size_t> activeWorkers{0};
+    std::mutex wakeMutex;
+    std::condition_variable wakeCondition;
+    std::atomic<size_t> pendingTasks{0};
+    std::atomic<size_t> nextQueue{0};
+    bool stopping = false;
+};
+
+// 协作式取消标记
+// 发起方调用 cancel(), 执行方在合适的粒度(例如每个块)检查 isCancelled() 并尽快返回
+class CancellationToken
+{
+    std::atomic<bool> cancelled{false};
+
+public:
+    inline void cancel() { cancelled.store(true, std::memory_order_release); }
+    inline void reset() { cancelled.store(false, std::memory_order_relaxed); }
+    inline bool isCancelled() const { return cancelled.load(std::memory_order_acquire); }
+};
+
+// 一组任务的汇合点
+// wait() 在等待期间执行池中的任务, 返回时组内任务全部完成; 任务抛出的第一个异常在 wait() 中重新抛出
+class TaskGroup
+{
+    ThreadPool &pool;
+    std::atomic<size_t> remaining{0};
+    std::mutex errorMutex;
+    std::exception_ptr firstError;
+
+public:
+    explicit TaskGroup(ThreadPool &_pool = ThreadPool::Global()) : pool(_pool) {}
+    TaskGroup(const TaskGroup &) = delete;
+    TaskGroup &operator=(const TaskGroup &) = delete;
+    ~TaskGroup()
+    {
+        // 任务引用了本对象, 必须等它们结束
+        while (remaining.load(std::memory_order_acquire) > 0)
+        {
+            if (!pool.tryRunOne())
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    template <typename F>
+    void run(F &&func)
+    {
+        remaining.fetch_add(1, std::memory_order_relaxed);
+        pool.push([this, func = std::forward<F>(func)]() mutable
+                  {
+                      try
+                      {
+                          func();
+                      }
+                      catch (...)
+                      {
+                          std::lock_guard<std::mutex> lock(errorMutex);
+                          if (!firstError)
+                          {
+                              firstError = std::current_exception();
+                          }
+                      }
+                      remaining.fetch_sub(1, std::memory_order_release); });
+    }
+
+    inline void wait()
+    {
+        while (remaining.load(std::memory_order_acquire) > 0)
+        {
+            if (!pool.tryRunOne())
+            {
+                std::this_thread::yield();
+            }
+        }
+        std::exception_ptr error;
+        {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            std::swap(error, firstError);
+        }
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+};
@@ -9,6 +9,7 @@
 #include <string>
 #include <chrono>
 #include <unordered_map>
+#include <cstdint>
 
 using point3 = glm::vec3;
 using point2 = glm::vec2;
@@ -90,5 +91,21 @@ namespace Profiler
     void BeginTimeBlock(const std::string& name);
     void EndTimeBlock(const std::string& name);
 
+    // sd CPU 路径的长度与结束原因统计
+    // 追踪线程先在线程局部累计, 每 256 条路径并入全局计数, 避免每条路径都争用同一缓存行
+    enum class PathEnd
+    {
+        Emitter,     // 命中光源
+        Sky,         // 未命中场景
+        Absorbed,    // BSDF 采样失败
+        Cache,       // 命中辐射缓存
+        Roulette,    // 被俄罗斯轮盘终止
+        BounceLimit, // 达到 bounceLimit
+        Count
+    };
+    inline constexpr int kMaxTrackedPathLength = 16; // 更长的路径计入最后一格
+    void RecordPath(int length, PathEnd end);
+    void ResetPathStats();
+
     void RenderUI();
 } // namespace Profiler
\ No newline at end of file
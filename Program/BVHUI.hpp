@@ -72,12 +72,12 @@ public:
         {
             depth = top;
             uint32_t index = callStack[--top];
-            const sd::Node &node = dataStorage.nodeStorage.nodes[index];
-
             if (index == sd::invalidIndex)
             {
                 continue;
             }
+            const sd::Node &node = dataStorage.nodeStorage.nodes[index];
+
             if (node.flags == sd::NODE_LEAF) // 叶子节点
             {
                 if (!showLeafAABB)
@@ -0,0 +1,553 @@
+#include "Benchmark.hpp"
+#include "ArenaAllocator.hpp"
+#include "Camera.hpp"
+#include "Materials/Lambertian.hpp"
+#include "Materials/LightEmit.hpp"
+#include "Random.hpp"
+#include "Storage.hpp"
+#include "ThreadPool.hpp"
+#include "Trace.hpp"
+#include "UICommon.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <latch>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+
+namespace Benchmark
+{
+    namespace
+    {
+        // 模拟场景数据与每像素的少量计算, 让锁开销与真实着色相比有参照
+        struct FakeScene
+        {
+            float payload[16] = {};
+        };
+
+        inline float ShadePixel(const FakeScene &scene, size_t pixel)
+        {
+            float value = static_cast<float>(pixel & 0xff);
+            for (float p : scene.payload)
+            {
+                value = value * 0.5f + p;
+            }
+            return value;
+        }
+
+        // 以 threads 个线程各处理 pixelsPerThread 个像素, 返回百万像素每秒
+        template <typename Worker>
+        double MeasureThroughput(int threads, size_t pixelsPerThread, Worker &&worker)
+        {
+            std::latch start(threads + 1);
+            std::vector<std::thread> pool;
+            pool.reserve(threads);
+            std::atomic<float> sink{0.0f};
+            for (int i = 0; i < threads; ++i)
+            {
+                pool.emplace_back([&]()
+                                  {
+                                      start.arrive_and_wait();
+                                      float local = worker(pixelsPerThread);
+                                      sink.fetch_add(local, std::memory_order_relaxed); });
+            }
+            auto begin = std::chrono::steady_clock::now();
+            start.arrive_and_wait();
+            for (auto &thread : pool)
+            {
+                thread.join();
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+            return static_cast<double>(pixelsPerThread) * threads / std::max(seconds, 1e-9) / 1e6;
+        }
+
+        std::shared_ptr<const sd::Scene> PinSdScene()
+        {
+            std::shared_lock<std::shared_mutex> lock(Storage::SdSceneMutex);
+            return Storage::SdScene.snapshot();
+        }
+
+        // 采样器比较用的小图, 与 TraceCPUBase 相同的像素抖动与播种方式
+        struct SamplerImage
+        {
+            static constexpr size_t kWidth = 96;
+            static constexpr size_t kHeight = 54;
+            std::vector<glm::vec3> sum = std::vector<glm::vec3>(kWidth * kHeight, glm::vec3(0.0f));
+            std::vector<float> lumaSquareSum = std::vector<float>(kWidth * kHeight, 0.0f);
+            int samples = 0;
+
+            // 每像素追加一个采样, 行并行
+            void addPass(const sd::Scene &scene, const Camera &cam, Random::SamplerType type, uint64_t epoch, Trace::LightSelection selection = Trace::LightSelection::Tree)
+            {
+                // 基准在后台线程运行, 使用默认设置而不读 UI
+                Trace::PathOptions options;
+                options.settings.lightSelection = selection;
+                TaskGroup group(ThreadPool::Global());
+                for (size_t y = 0; y < kHeight; ++y)
+                {
+                    group.run([&, y]()
+                              {
+                                  Camera localCam = cam;
+                                  const sd::DataStorage &storage = scene.storageForNode(Arena::CurrentNumaNode());
+                                  for (size_t x = 0; x < kWidth; ++x)
+                                  {
+                                      Random::SeedSample(static_cast<uint32_t>(x), static_cast<uint32_t>(y), samples, epoch, type, false);
+                                      glm::vec2 jitter = Random::Sample2D();
+                                      glm::vec2 uv((x + jitter.x) / kWidth, (y + jitter.y) / kHeight);
+                                      glm::vec3 color = glm::vec3(Trace::CastRay(Ray(localCam.position, localCam.getRayDirction(uv)), 0, storage, options));
+                                      float luma = 0.2126f * color.r + 0.7152f * color.g + 0.0722f * color.b;
+                                      sum[y * kWidth + x] += color;
+                                      lumaSquareSum[y * kWidth + x] += luma * luma;
+                                  } });
+                }
+                group.wait();
+                ++samples;
+            }
+
+            double rmse(const SamplerImage &reference) const
+            {
+                double error = 0.0;
+                for (size_t i = 0; i < sum.size(); ++i)
+                {
+                    glm::vec3 diff = sum[i] / float(samples) - reference.sum[i] / float(reference.samples);
+                    error += glm::dot(diff, diff) / 3.0;
+                }
+                return std::sqrt(error / static_cast<double>(sum.size()));
+            }
+
+            // 每像素单个采样亮度方差的平均
+            double meanVariance() const
+            {
+                double variance = 0.0;
+                for (size_t i = 0; i < sum.size(); ++i)
+                {
+                    double mean = 0.2126 * sum[i].r / samples + 0.7152 * sum[i].g / samples + 0.0722 * sum[i].b / samples;
+                    variance += std::max(lumaSquareSum[i] / samples - mean * mean, 0.0);
+                }
+                return variance / static_cast<double>(sum.size());
+            }
+        };
+
+        // 以 sd::Mesh 加入一个水平正方形, 不重建顶层BVH
+        void AddQuad(sd::Scene &scene, const glm::vec3 &center, float size, const Material &material)
+        {
+            const float half = size * 0.5f;
+            const glm::vec3 normal(0.0f, 1.0f, 0.0f);
+            std::vector<sd::Vertex> vertices = {
+                {center + glm::vec3(-half, 0.0f, -half), normal, glm::vec2(0.0f, 0.0f)},
+                {center + glm::vec3(-half, 0.0f, half), normal, glm::vec2(0.0f, 1.0f)},
+                {center + glm::vec3(half, 0.0f, half), normal, glm::vec2(1.0f, 1.0f)},
+                {center + glm::vec3(half, 0.0f, -half), normal, glm::vec2(1.0f, 0.0f)}};
+            std::vector<unsigned int> indices = {0, 1, 2, 0, 2, 3};
+            sd::Mesh mesh(*scene.pDataStorage, vertices, indices, material);
+            scene.sceneIndices.push_back(mesh.meshNodeIndex);
+        }
+
+        // 城市夜景式的多光源场景: 60x60 的地面, 上方 0.5~3.5 高度散布小面光源
+        std::unique_ptr<sd::Scene> BuildManyLightsScene(int lightCount)
+        {
+            constexpr float kLightSize = 0.3f;
+            constexpr float kTotalPower = 400.0f; // 亮度 * 面积 之和, 不随光源数改变
+            auto scene = std::make_unique<sd::Scene>();
+            AddQuad(*scene, glm::vec3(0.0f), 60.0f, Lambertian(color4(0.8f, 0.8f, 0.8f, 1.0f)));
+            Random::PCG32 rng(static_cast<uint64_t>(lightCount), 7);
+            const float baseEmission = kTotalPower / (lightCount * kLightSize * kLightSize);
+            for (int i = 0; i < lightCount; ++i)
+            {
+                glm::vec3 center(rng.nextFloat() * 50.0f - 25.0f, 0.5f + rng.nextFloat() * 3.0f, rng.nextFloat() * 50.0f - 25.0f);
+                // 亮度在 0.2~1.8 倍之间变化, 均值不变
+                float scale = 0.2f + rng.nextFloat() * 1.6f;
+                color4 emission(baseEmission * scale, baseEmission * scale * 0.8f, baseEmission * scale * 0.5f, 1.0f);
+                AddQuad(*scene, center, kLightSize, LightEmit(emission));
+            }
+            auto &storage = *scene->pDataStorage;
+            storage.rootIndex = sd::BVH::BuildBVHFromNodes(storage.nodeStorage, scene->sceneIndices.data(), 0, scene->sceneIndices.size());
+            storage.lightTree.build(storage.triangleStorage, storage.emitters);
+            return scene;
+        }
+    }
+
+    std::vector<ContentionResult> RunSceneLockContention(const std::vector<int> &threadCounts, size_t pixelsPerThread)
+    {
+        constexpr size_t kTilePixels = 16 * 16;
+        std::shared_mutex sceneMutex;
+        FakeScene lockedScene;
+        Storage::SnapshotPublisher<FakeScene> publisher;
+        publisher.publish(std::make_shared<const FakeScene>());
+
+        std::vector<ContentionResult> results;
+        for (int threads : threadCounts)
+        {
+            ContentionResult result;
+            result.threads = threads;
+            result.perPixelLock = MeasureThroughput(threads, pixelsPerThread, [&](size_t pixels)
+                                                    {
+                                                        float sum = 0.0f;
+                                                        for (size_t i = 0; i < pixels; ++i)
+                                                        {
+                                                            std::shared_lock<std::shared_mutex> lock(sceneMutex);
+                                                            sum += ShadePixel(lockedScene, i);
+                                                        }
+                                                        return sum; });
+            result.perPixelPin = MeasureThroughput(threads, pixelsPerThread, [&](size_t pixels)
+                                                   {
+                                                       float sum = 0.0f;
+                                                       for (size_t i = 0; i < pixels; ++i)
+                                                       {
+                                                           auto scene = publisher.pin();
+                                                           sum += ShadePixel(*scene, i);
+                                                       }
+                                                       return sum; });
+            result.perTilePin = MeasureThroughput(threads, pixelsPerThread, [&](size_t pixels)
+                                                  {
+                                                      float sum = 0.0f;
+                                                      for (size_t tile = 0; tile < pixels; tile += kTilePixels)
+                                                      {
+                                                          auto scene = publisher.pin();
+                                                          for (size_t i = tile; i < std::min(pixels, tile + kTilePixels); ++i)
+                                                          {
+                                                              sum += ShadePixel(*scene, i);
+                                                          }
+                                                      }
+                                                      return sum; });
+            auto frameScene = publisher.pin();
+            result.perFramePin = MeasureThroughput(threads, pixelsPerThread, [&](size_t pixels)
+                                                   {
+                                                       float sum = 0.0f;
+                                                       for (size_t i = 0; i < pixels; ++i)
+                                                       {
+                                                           sum += ShadePixel(*frameScene, i);
+                                                       }
+                                                       return sum; });
+            results.push_back(result);
+        }
+        return results;
+    }
+
+    std::vector<ScalingResult> RunThreadScaling(const Camera &cam, const std::vector<int> &threadCounts, bool pinThreads, bool useSMT, size_t raysPerRun)
+    {
+        constexpr size_t kChunkRays = 1024;
+        constexpr size_t kImageSize = 512; // 光线取自当前视角下 512x512 的像素网格
+        auto scene = PinSdScene();
+        if (!scene)
+        {
+            return {};
+        }
+
+        std::vector<ScalingResult> results;
+        for (int threads : threadCounts)
+        {
+            ThreadPool pool(ThreadPool::Config{static_cast<size_t>(std::max(threads, 1)), pinThreads, useSMT});
+            std::atomic<size_t> nextChunk{0};
+            std::atomic<size_t> hits{0};
+            auto begin = std::chrono::steady_clock::now();
+            {
+                TaskGroup group(pool);
+                for (size_t worker = 0; worker < pool.size(); ++worker)
+                {
+                    group.run([&]()
+                              {
+                                  Camera localCam = cam;
+                                  const sd::DataStorage &storage = scene->storageForNode(Arena::CurrentNumaNode());
+                                  size_t localHits = 0;
+                                  for (size_t chunk = nextChunk.fetch_add(kChunkRays); chunk < raysPerRun; chunk = nextChunk.fetch_add(kChunkRays))
+                                  {
+                                      for (size_t i = chunk; i < std::min(raysPerRun, chunk + kChunkRays); ++i)
+                                      {
+                                          size_t pixel = i % (kImageSize * kImageSize);
+                                          glm::vec2 uv((pixel % kImageSize + 0.5f) / kImageSize, (pixel / kImageSize + 0.5f) / kImageSize);
+                                          Ray ray(localCam.position, localCam.getRayDirction(uv));
+                                          localHits += sd::BVH::IntersectLoop(storage, ray).hit ? 1 : 0;
+                                      }
+                                  }
+                                  hits.fetch_add(localHits, std::memory_order_relaxed); });
+                }
+                group.wait();
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+            ScalingResult result;
+            result.threads = threads;
+            result.raysPerSecond = static_cast<double>(raysPerRun) / std::max(seconds, 1e-9) / 1e6;
+            if (!results.empty() && results.front().raysPerSecond > 0.0)
+            {
+                result.speedup = result.raysPerSecond / results.front().raysPerSecond;
+                result.efficiency = result.speedup * results.front().threads / threads;
+            }
+            else
+            {
+                result.speedup = 1.0;
+                result.efficiency = 1.0;
+            }
+            results.push_back(result);
+        }
+        return results;
+    }
+
+    std::vector<SamplerResult> RunSamplerComparison(const Camera &cam, const std::vector<double> &budgetsMs, int referenceSamples)
+    {
+        auto scene = PinSdScene();
+        if (!scene)
+        {
+            return {};
+        }
+        // 参考图用独立采样, 与被测的两种采样器都不相关
+        SamplerImage reference;
+        for (int i = 0; i < referenceSamples; ++i)
+        {
+            reference.addPass(*scene, cam, Random::SamplerType::Independent, 1);
+        }
+
+        std::vector<SamplerResult> results;
+        for (double budget : budgetsMs)
+        {
+            for (auto type : {Random::SamplerType::Independent, Random::SamplerType::Sobol})
+            {
+                SamplerImage image;
+                auto begin = std::chrono::steady_clock::now();
+                do
+                {
+                    image.addPass(*scene, cam, type, 2);
+                } while (std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count() < budget);
+
+                SamplerResult result;
+                result.sampler = static_cast<int>(type);
+                result.budgetMs = budget;
+                result.samplesPerPixel = image.samples;
+                result.rmse = image.rmse(reference);
+                results.push_back(result);
+            }
+        }
+        return results;
+    }
+
+    std::vector<LightSelectionResult> RunLightSelection(const std::vector<int> &lightCounts, int samplesPerPixel)
+    {
+        const Camera cam(1.0f, point3(0.0f, 18.0f, 26.0f), 2.0f, float(16) / float(9), point3(0.0f));
+        std::vector<LightSelectionResult> results;
+        for (int lights : lightCounts)
+        {
+            auto scene = BuildManyLightsScene(lights);
+            for (auto selection : {Trace::LightSelection::Area, Trace::LightSelection::Tree})
+            {
+                SamplerImage image;
+                auto begin = std::chrono::steady_clock::now();
+                for (int i = 0; i < samplesPerPixel; ++i)
+                {
+                    image.addPass(*scene, cam, Random::SamplerType::Independent, 3, selection);
+                }
+                LightSelectionResult result;
+                result.lights = lights;
+                result.selection = static_cast<int>(selection);
+                result.samplesPerPixel = image.samples;
+                result.timeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+                result.variance = image.meanVariance();
+                results.push_back(result);
+            }
+        }
+        return results;
+    }
+
+    void RenderUI(const Camera &cam)
+    {
+        static std::future<std::vector<ContentionResult>> contentionFuture;
+        static std::vector<ContentionResult> contentionResults;
+        static std::future<std::vector<ScalingResult>> scalingFuture;
+        static std::vector<ScalingResult> scalingResults;
+        static std::future<std::vector<SamplerResult>> samplerFuture;
+        static std::vector<SamplerResult> samplerResults;
+        static std::future<std::vector<LightSelectionResult>> lightFuture;
+        static std::vector<LightSelectionResult> lightResults;
+        static bool scalingPin = false;
+        static bool scalingSMT = true;
+        static int maxThreads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()) * 2);
+
+        ImGui::Begin("Benchmarks");
+        {
+            bool running = contentionFuture.valid();
+            if (running && contentionFuture.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+            {
+                contentionResults = contentionFuture.get();
+                running = false;
+            }
+
+            ImGui::DragInt("Max Threads", &maxThreads, 1, 1, 256);
+            if (running)
+            {
+                ImGui::Text("Scene Lock Contention: running...");
+            }
+            else if (ImGui::Button("Scene Lock Contention"))
+            {
+                std::vector<int> threadCounts;
+                for (int threads = 1; threads < maxThreads; threads *= 2)
+                {
+                    threadCounts.push_back(threads);
+                }
+                threadCounts.push_back(maxThreads);
+                contentionFuture = std::async(std::launch::async, RunSceneLockContention, threadCounts, size_t(1) << 20);
+            }
+
+            if (!contentionResults.empty() && ImGui::BeginTable("SceneLockContention", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+            {
+                ImGui::TableSetupColumn("Threads");
+                ImGui::TableSetupColumn("Lock/Pixel");
+                ImGui::TableSetupColumn("Pin/Pixel");
+                ImGui::TableSetupColumn("Pin/Tile");
+                ImGui::TableSetupColumn("Pin/Frame");
+                ImGui::TableHeadersRow();
+                for (const auto &result : contentionResults)
+                {
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%d", result.threads);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.1f", result.perPixelLock);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.1f", result.perPixelPin);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.1f", result.perTilePin);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.1f", result.perFramePin);
+                }
+                ImGui::EndTable();
+                ImGui::TextUnformatted("Mpixels/s");
+            }
+
+            ImGui::Separator();
+            bool scaling = scalingFuture.valid();
+            if (scaling && scalingFuture.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+            {
+                scalingResults = scalingFuture.get();
+                scaling = false;
+            }
+            ImGui::Checkbox("Pin Threads", &scalingPin);
+            ImGui::SameLine();
+            ImGui::Checkbox("SMT", &scalingSMT);
+            if (scaling)
+            {
+                ImGui::Text("Thread Scaling: running...");
+            }
+            else if (ImGui::Button("Thread Scaling"))
+            {
+                // 1, 2, 4, ... 直到按 SMT 策略可用的逻辑处理器数
+                const int processors = static_cast<int>(ThreadPool::LogicalProcessors(scalingSMT).size());
+                std::vector<int> threadCounts;
+                for (int threads = 1; threads < processors; threads *= 2)
+                {
+                    threadCounts.push_back(threads);
+                }
+                threadCounts.push_back(processors);
+                scalingFuture = std::async(std::launch::async, RunThreadScaling, cam, threadCounts, scalingPin, scalingSMT, size_t(1) << 21);
+            }
+
+            if (!scalingResults.empty() && ImGui::BeginTable("ThreadScaling", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+            {
+                ImGui::TableSetupColumn("Threads");
+                ImGui::TableSetupColumn("Mrays/s");
+                ImGui::TableSetupColumn("Speedup");
+                ImGui::TableSetupColumn("Efficiency");
+                ImGui::TableHeadersRow();
+                for (const auto &result : scalingResults)
+                {
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%d", result.threads);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.2f", result.raysPerSecond);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.2fx", result.speedup);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.0f%%", result.efficiency * 100.0);
+                }
+                ImGui::EndTable();
+            }
+
+            ImGui::Separator();
+            bool comparing = samplerFuture.valid();
+            if (comparing && samplerFuture.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+            {
+                samplerResults = samplerFuture.get();
+                comparing = false;
+            }
+            if (comparing)
+            {
+                ImGui::Text("Sampler RMSE: running...");
+            }
+            else if (ImGui::Button("Sampler RMSE (Equal Time)"))
+            {
+                samplerFuture = std::async(std::launch::async, RunSamplerComparison, cam, std::vector<double>{50.0, 200.0, 800.0}, 1024);
+            }
+
+            if (!samplerResults.empty() && ImGui::BeginTable("SamplerRMSE", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+            {
+                static const char *samplerNames[] = {"Independent", "Sobol (Owen)"};
+                ImGui::TableSetupColumn("Budget (ms)");
+                ImGui::TableSetupColumn("Sampler");
+                ImGui::TableSetupColumn("spp");
+                ImGui::TableSetupColumn("RMSE");
+                ImGui::TableHeadersRow();
+                for (const auto &result : samplerResults)
+                {
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.0f", result.budgetMs);
+                    ImGui::TableNextColumn();
+                    ImGui::TextUnformatted(samplerNames[result.sampler]);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%d", result.samplesPerPixel);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.5f", result.rmse);
+                }
+                ImGui::EndTable();
+            }
+
+            ImGui::Separator();
+            bool lightRunning = lightFuture.valid();
+            if (lightRunning && lightFuture.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+            {
+                lightResults = lightFuture.get();
+                lightRunning = false;
+            }
+            if (lightRunning)
+            {
+                ImGui::Text("Many Lights: running...");
+            }
+            else if (ImGui::Button("Many Lights Variance"))
+            {
+                lightFuture = std::async(std::launch::async, RunLightSelection, std::vector<int>{16, 256, 4096}, 64);
+            }
+
+            if (!lightResults.empty() && ImGui::BeginTable("ManyLights", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+            {
+                static const char *selectionNames[] = {"Area", "Light BVH"};
+                ImGui::TableSetupColumn("Lights");
+                ImGui::TableSetupColumn("Selection");
+                ImGui::TableSetupColumn("spp");
+                ImGui::TableSetupColumn("Time (ms)");
+                ImGui::TableSetupColumn("Variance");
+                ImGui::TableHeadersRow();
+                for (const auto &result : lightResults)
+                {
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%d", result.lights);
+                    ImGui::TableNextColumn();
+                    ImGui::TextUnformatted(selectionNames[result.selection]);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%d", result.samplesPerPixel);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.0f", result.timeMs);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.4f", result.variance);
+                }
+                ImGui::EndTable();
+            }
+        }
+        ImGui::End();
+    }
+}
@@ -0,0 +1,148 @@
+#include "BlueNoise.hpp"
+#include "Random.hpp"
+
+#include <algorithm>
+#include <limits>
+
+namespace BlueNoise
+{
+    namespace
+    {
+        constexpr uint32_t kPixels = kSize * kSize;
+        constexpr float kSigma = 1.5f;
+
+        // 环形距离的高斯能量, energy[p] 为所有已放置点对 p 的贡献之和
+        class EnergyField
+        {
+            std::vector<float> kernel = std::vector<float>(kPixels);
+            std::vector<float> energy = std::vector<float>(kPixels, 0.0f);
+
+        public:
+            std::vector<uint8_t> points = std::vector<uint8_t>(kPixels, 0);
+
+            EnergyField()
+            {
+                for (uint32_t y = 0; y < kSize; ++y)
+                {
+                    for (uint32_t x = 0; x < kSize; ++x)
+                    {
+                        float dx = static_cast<float>(std::min(x, kSize - x));
+                        float dy = static_cast<float>(std::min(y, kSize - y));
+                        kernel[y * kSize + x] = std::exp(-(dx * dx + dy * dy) / (2.0f * kSigma * kSigma));
+                    }
+                }
+            }
+
+            void toggle(uint32_t p)
+            {
+                const float sign = points[p] ? -1.0f : 1.0f;
+                points[p] ^= 1;
+                const uint32_t px = p % kSize;
+                const uint32_t py = p / kSize;
+                for (uint32_t y = 0; y < kSize; ++y)
+                {
+                    const uint32_t ky = ((y + kSize - py) % kSize) * kSize;
+                    for (uint32_t x = 0; x < kSize; ++x)
+                    {
+                        energy[y * kSize + x] += sign * kernel[ky + (x + kSize - px) % kSize];
+                    }
+                }
+            }
+
+            // 最紧的团: 能量最大的点; 最大的空隙: 能量最小的空位
+            uint32_t tightestCluster() const
+            {
+                uint32_t best = 0;
+                float bestEnergy = -1.0f;
+                for (uint32_t p = 0; p < kPixels; ++p)
+                {
+                    if (points[p] && energy[p] > bestEnergy)
+                    {
+                        bestEnergy = energy[p];
+                        best = p;
+                    }
+                }
+                return best;
+            }
+            uint32_t largestVoid() const
+            {
+                uint32_t best = 0;
+                float bestEnergy = std::numeric_limits<float>::max();
+                for (uint32_t p = 0; p < kPixels; ++p)
+                {
+                    if (!points[p] && energy[p] < bestEnergy)
+                    {
+                        bestEnergy = energy[p];
+                        best = p;
+                    }
+                }
+                return best;
+            }
+        };
+
+        // Ulichney void-and-cluster, 返回每个像素的排名
+        std::vector<uint32_t> GenerateRanks(uint64_t seed)
+        {
+            EnergyField field;
+            Random::PCG32 rng(seed, 0);
+            const uint32_t initialPoints = kPixels / 10;
+            for (uint32_t placed = 0; placed < initialPoints;)
+            {
+                uint32_t p = rng.next() % kPixels;
+                if (!field.points[p])
+                {
+                    field.toggle(p);
+                    ++placed;
+                }
+            }
+            // 把初始点集松弛为均匀分布: 反复把最紧的团移到最大的空隙, 直到不再移动
+            for (uint32_t iteration = 0; iteration < kPixels; ++iteration)
+            {
+                uint32_t cluster = field.tightestCluster();
+                field.toggle(cluster);
+                uint32_t emptiest = field.largestVoid();
+                field.toggle(emptiest);
+                if (emptiest == cluster)
+                {
+                    break;
+                }
+            }
+
+            std::vector<uint32_t> ranks(kPixels, 0);
+            // 阶段一: 从原型中依次移除最紧的团, 排名递减
+            EnergyField removal = field;
+            for (uint32_t rank = initialPoints; rank-- > 0;)
+            {
+                uint32_t cluster = removal.tightestCluster();
+                removal.toggle(cluster);
+                ranks[cluster] = rank;
+            }
+            // 阶段二: 从原型开始依次填入最大的空隙, 排名递增
+            for (uint32_t rank = initialPoints; rank < kPixels; ++rank)
+            {
+                uint32_t emptiest = field.largestVoid();
+                field.toggle(emptiest);
+                ranks[emptiest] = rank;
+            }
+            return ranks;
+        }
+    }
+
+    const std::vector<float> &Mask()
+    {
+        static const std::vector<float> mask = []()
+        {
+            std::vector<float> values(kPixels * 2);
+            for (int channel = 0; channel < 2; ++channel)
+            {
+                auto ranks = GenerateRanks(0x9e3779b97f4a7c15ULL + channel);
+                for (uint32_t p = 0; p < kPixels; ++p)
+                {
+                    values[p * 2 + channel] = (static_cast<float>(ranks[p]) + 0.5f) / static_cast<float>(kPixels);
+                }
+            }
+            return values;
+        }();
+        return mask;
+    }
+}
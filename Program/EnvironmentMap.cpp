@@ -0,0 +1,347 @@
+#include "EnvironmentMap.hpp"
+#include "Shader.hpp"
+#include "UI.hpp"
+#include "ThreadPool.hpp"
+
+#include <glm/gtc/constants.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <future>
+
+namespace
+{
+    std::atomic<std::shared_ptr<const EnvironmentMap>> Published;
+    std::atomic<uint64_t> PublishedGeneration{0};
+
+    constexpr double kObserverHeight = 1.0;      // 观察点离地高度, 天空与场景原点处相同
+    constexpr double kSunAngularRadius = 0.0093; // 约为真实太阳的两倍, 使圆盘在表中跨过几个纹素
+    constexpr int kSunSubsamples = 4;            // 太阳圆盘对纹素的覆盖率按 4x4 子采样估计
+
+    inline glm::vec3 TexelDirection(double u, double v)
+    {
+        double theta = v * glm::pi<double>();
+        double phi = u * 2.0 * glm::pi<double>();
+        return glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+    }
+
+    inline void DirectionToTexel(const glm::vec3 &dir, int &x, int &y, float &sinTheta)
+    {
+        float cosTheta = std::clamp(dir.y, -1.0f, 1.0f);
+        float phi = std::atan2(dir.z, dir.x);
+        if (phi < 0.0f)
+        {
+            phi += 2.0f * glm::pi<float>();
+        }
+        sinTheta = std::sqrt(std::max(1.0f - cosTheta * cosTheta, 0.0f));
+        x = std::min(static_cast<int>(phi * glm::one_over_two_pi<float>() * EnvironmentMap::kWidth), EnvironmentMap::kWidth - 1);
+        y = std::min(static_cast<int>(std::acos(cosTheta) * glm::one_over_pi<float>() * EnvironmentMap::kHeight), EnvironmentMap::kHeight - 1);
+    }
+
+    // skyTex.fs 的单次散射天空在 CPU 上的实现. 距离在地球半径量级, 用双精度
+    class SkyModel
+    {
+        const EnvironmentMap::Parameters &p;
+        glm::dvec3 earthCenter;
+        glm::dvec3 camPos;
+        glm::dvec3 sunDir;
+        glm::dvec3 sunColor;
+        glm::dvec3 betaMie;
+        const glm::dvec3 betaRayleigh = glm::dvec3(5.8e-6, 1.35e-5, 3.31e-5);
+        const glm::dvec3 betaMieAbsorb = glm::dvec3(2.5e-5, 4e-5, 1e-5);
+
+    public:
+        glm::dvec3 sunlightDecay; // 观察点处太阳光的透射率, 太阳在地平线下时为 0
+
+        SkyModel(const EnvironmentMap::Parameters &parameters) : p(parameters)
+        {
+            earthCenter = glm::dvec3(0.0, -p.earthRadius, 0.0);
+            camPos = glm::dvec3(0.0, kObserverHeight, 0.0);
+            sunDir = glm::dvec3(p.sunDir);
+            sunColor = glm::dvec3(p.sunColor);
+            betaMie = glm::dvec3(p.betaMie);
+            sunlightDecay = intersectSphere(camPos, sunDir, p.earthRadius) > 0.0
+                                ? glm::dvec3(0.0)
+                                : transmittance(camPos, camPos + sunDir * intersectSphere(camPos, sunDir, atmosphereRadius()));
+        }
+
+        inline double atmosphereRadius() const { return double(p.earthRadius) + p.skyHeight; }
+
+        // 射线与以地心为球心的球面的第一个正向交点参数, 没有时返回 -1. dir 为单位向量
+        double intersectSphere(const glm::dvec3 &ori, const glm::dvec3 &dir, double radius) const
+        {
+            glm::dvec3 relative = ori - earthCenter;
+            double b = glm::dot(relative, dir);
+            double c = glm::dot(relative, relative) - radius * radius;
+            double discriminant = b * b - c;
+            if (discriminant < 0.0)
+            {
+                return -1.0;
+            }
+            double s = std::sqrt(discriminant);
+            if (-b - s > 0.0)
+            {
+                return -b - s;
+            }
+            return -b + s > 0.0 ? -b + s : -1.0;
+        }
+
+        inline double height(const glm::dvec3 &point) const { return glm::length(point - earthCenter) - p.earthRadius; }
+        inline double rhoRayleigh(double h) const { return p.atmosphereDensity * std::exp(-std::max(h, 0.0) / p.HRayleigh); }
+        inline double rhoMie(double h) const { return p.MieDensity * std::exp(-std::max(h, 0.0) / p.HMie); }
+
+        glm::dvec3 transmittance(const glm::dvec3 &ori, const glm::dvec3 &end) const
+        {
+            constexpr int kSteps = 64;
+            double interval = glm::length(end - ori) / kSteps;
+            double depthMie = 0.0;
+            double depthRayleigh = 0.0;
+            for (int i = 0; i < kSteps; ++i)
+            {
+                double h = height(ori + (end - ori) * (double(i) / kSteps));
+                depthMie += interval * rhoMie(h);
+                depthRayleigh += interval * rhoRayleigh(h);
+            }
+            glm::dvec3 extinction = (betaMie + betaMieAbsorb * double(p.absorbMie)) * depthMie + betaRayleigh * depthRayleigh;
+            return glm::exp(-extinction);
+        }
+
+        // 沿视线 [0, distance] 累积的单次散射
+        glm::dvec3 inscatter(const glm::dvec3 &dir, double distance) const
+        {
+            const int steps = std::max(p.maxStep, 1);
+            double interval = distance / steps;
+            glm::dvec3 rayleigh(0.0);
+            glm::dvec3 mie(0.0);
+            for (int i = 0; i < steps; ++i)
+            {
+                glm::dvec3 point = camPos + dir * (i * interval);
+                double tSky = intersectSphere(point, sunDir, atmosphereRadius());
+                double tEarth = intersectSphere(point, sunDir, p.earthRadius);
+                if (tEarth > 0.0 && tEarth < tSky)
+                {
+                    continue; // 散射点的阳光被地面阻挡
+                }
+                glm::dvec3 t = transmittance(camPos, point) * transmittance(point, point + sunDir * std::max(tSky, 0.0));
+                double h = height(point);
+                rayleigh += betaRayleigh * rhoRayleigh(h) * t;
+                mie += betaMie * rhoMie(h) * t;
+            }
+            double cosine = glm::dot(dir, sunDir);
+            double phaseRayleigh = 3.0 / 16.0 * glm::pi<double>() * (1.0 + cosine * cosine);
+            double g = p.gMie;
+            double phaseMie = (1.0 - g * g) / std::pow(1.0 + g * g - 2.0 * g * cosine, 1.5);
+            return sunColor * (rayleigh * phaseRayleigh + mie * phaseMie * double(p.MieIntensity)) * interval;
+        }
+
+        glm::dvec3 radiance(const glm::dvec3 &dir) const
+        {
+            double tEarth = intersectSphere(camPos, dir, p.earthRadius);
+            if (tEarth > 0.0)
+            {
+                // 大气透视加上被太阳照亮的地面
+                glm::dvec3 hit = camPos + dir * tEarth;
+                glm::dvec3 normal = glm::normalize(hit - earthCenter);
+                glm::dvec3 lighting = sunColor * std::max(0.0, glm::dot(normal, sunDir)) * sunlightDecay;
+                return inscatter(dir, tEarth) + lighting * glm::dvec3(0.3, 0.3, 0.34) * transmittance(camPos, hit);
+            }
+            double tSky = intersectSphere(camPos, dir, atmosphereRadius());
+            return tSky > 0.0 ? inscatter(dir, tSky) * double(p.skyIntensity) : glm::dvec3(0.0);
+        }
+
+        // 太阳圆盘: 透射后的太阳光照度均匀分布在圆盘立体角内, 按覆盖率计入纹素
+        glm::dvec3 sunDisk(int x, int y) const
+        {
+            const double texelAngle = glm::pi<double>() / EnvironmentMap::kHeight;
+            if (glm::dot(glm::dvec3(TexelDirection((x + 0.5) / EnvironmentMap::kWidth, (y + 0.5) / EnvironmentMap::kHeight)), sunDir) <
+                std::cos(kSunAngularRadius + 2.0 * texelAngle))
+            {
+                return glm::dvec3(0.0);
+            }
+            const double cosRadius = std::cos(kSunAngularRadius);
+            int covered = 0;
+            for (int sy = 0; sy < kSunSubsamples; ++sy)
+            {
+                for (int sx = 0; sx < kSunSubsamples; ++sx)
+                {
+                    glm::dvec3 dir(TexelDirection((x + (sx + 0.5) / kSunSubsamples) / EnvironmentMap::kWidth,
+                                                  (y + (sy + 0.5) / kSunSubsamples) / EnvironmentMap::kHeight));
+                    covered += glm::dot(dir, sunDir) >= cosRadius ? 1 : 0;
+                }
+            }
+            double coverage = double(covered) / (kSunSubsamples * kSunSubsamples);
+            double solidAngle = 2.0 * glm::pi<double>() * (1.0 - cosRadius);
+            return sunColor * sunlightDecay * (coverage / solidAngle);
+        }
+    };
+
+    EnvironmentMap::Parameters CurrentParameters()
+    {
+        EnvironmentMap::Parameters parameters;
+        parameters.skyHeight = SkySettings::skyHeight;
+        parameters.earthRadius = SkySettings::earthRadius;
+        parameters.skyIntensity = SkySettings::skyIntensity;
+        parameters.HRayleigh = SkySettings::HRayleigh;
+        parameters.HMie = SkySettings::HMie;
+        parameters.atmosphereDensity = SkySettings::atmosphereDensity;
+        parameters.MieDensity = SkySettings::MieDensity;
+        parameters.gMie = SkySettings::gMie;
+        parameters.absorbMie = SkySettings::absorbMie;
+        parameters.MieIntensity = SkySettings::MieIntensity;
+        parameters.betaMie = glm::vec3(SkySettings::betaMie);
+        parameters.maxStep = SkySettings::maxStep;
+        float length = glm::length(SkySettings::sunlightDir);
+        parameters.sunDir = length > 0.0f ? SkySettings::sunlightDir / length : glm::vec3(0.0f, 1.0f, 0.0f);
+        parameters.sunColor = glm::vec3(SkySettings::sunlightColor) * SkySettings::sunlightIntensity;
+        return parameters;
+    }
+}
+
+std::shared_ptr<const EnvironmentMap> EnvironmentMap::Build(const Parameters &parameters)
+{
+    auto map = std::make_shared<EnvironmentMap>();
+    map->radiance.resize(size_t(kWidth) * kHeight);
+    const SkyModel sky(parameters);
+    {
+        TaskGroup group(ThreadPool::Global());
+        for (int y = 0; y < kHeight; ++y)
+        {
+            group.run([&, y]()
+                      {
+                          for (int x = 0; x < kWidth; ++x)
+                          {
+                              glm::dvec3 dir(TexelDirection((x + 0.5) / kWidth, (y + 0.5) / kHeight));
+                              map->radiance[y * kWidth + x] = glm::vec3(sky.radiance(dir) + sky.sunDisk(x, y));
+                          } });
+        }
+        group.wait();
+    }
+    map->buildDistribution();
+    return map;
+}
+
+void EnvironmentMap::Update()
+{
+    static Parameters requested;
+    static bool hasRequest = false;
+    static std::future<std::shared_ptr<const EnvironmentMap>> building;
+    if (building.valid())
+    {
+        if (building.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            return; // 同时只建一张, 拖动参数期间的中间值被跳过
+        }
+        Published.store(building.get(), std::memory_order_release);
+        PublishedGeneration.fetch_add(1, std::memory_order_release);
+        RenderState::Dirty = true; // 天空改变, 已累计的采样作废
+    }
+    Parameters current = CurrentParameters();
+    if (hasRequest && current == requested)
+    {
+        return;
+    }
+    requested = current;
+    hasRequest = true;
+    building = std::async(std::launch::async, Build, current);
+}
+
+const EnvironmentMap *EnvironmentMap::Current()
+{
+    thread_local std::shared_ptr<const EnvironmentMap> pinned;
+    thread_local uint64_t pinnedGeneration = 0;
+    uint64_t generation = PublishedGeneration.load(std::memory_order_acquire);
+    if (generation != pinnedGeneration)
+    {
+        pinned = Published.load(std::memory_order_acquire);
+        pinnedGeneration = generation;
+    }
+    return pinned.get();
+}
+
+uint64_t EnvironmentMap::Generation()
+{
+    return PublishedGeneration.load(std::memory_order_acquire);
+}
+
+glm::vec3 EnvironmentMap::lookup(const glm::vec3 &dir) const
+{
+    int x, y;
+    float sinTheta;
+    DirectionToTexel(dir, x, y, sinTheta);
+    return radiance[y * kWidth + x];
+}
+
+// 分布函数 f = 亮度 * 行中心的 sinθ, 每行一个条件分布, 行积分构成边缘分布
+void EnvironmentMap::buildDistribution()
+{
+    conditionalCdf.assign(size_t(kHeight) * (kWidth + 1), 0.0f);
+    rowIntegrals.assign(kHeight, 0.0f);
+    marginalCdf.assign(kHeight + 1, 0.0f);
+    for (int y = 0; y < kHeight; ++y)
+    {
+        float sinTheta = std::sin((y + 0.5f) / kHeight * glm::pi<float>());
+        float *cdf = &conditionalCdf[size_t(y) * (kWidth + 1)];
+        for (int x = 0; x < kWidth; ++x)
+        {
+            cdf[x + 1] = cdf[x] + luminance(x, y) * sinTheta / kWidth;
+        }
+        rowIntegrals[y] = cdf[kWidth];
+        for (int x = 1; x <= kWidth; ++x)
+        {
+            cdf[x] = rowIntegrals[y] > 0.0f ? cdf[x] / rowIntegrals[y] : float(x) / kWidth;
+        }
+        marginalCdf[y + 1] = marginalCdf[y] + rowIntegrals[y] / kHeight;
+    }
+    marginalIntegral = marginalCdf[kHeight];
+    for (int y = 1; y <= kHeight; ++y)
+    {
+        marginalCdf[y] = marginalIntegral > 0.0f ? marginalCdf[y] / marginalIntegral : float(y) / kHeight;
+    }
+}
+
+glm::vec3 EnvironmentMap::sample(float u1, float u2, float &pdf) const
+{
+    pdf = 0.0f;
+    if (marginalIntegral <= 0.0f)
+    {
+        return glm::vec3(0.0f, 1.0f, 0.0f);
+    }
+    // 在分段常数的 CDF 中定位, 再在段内线性插值得到连续坐标
+    auto sampleCdf = [](const float *cdf, int count, float u, int &offset)
+    {
+        offset = std::clamp(static_cast<int>(std::upper_bound(cdf, cdf + count + 1, u) - cdf) - 1, 0, count - 1);
+        float width = cdf[offset + 1] - cdf[offset];
+        return (offset + (width > 0.0f ? (u - cdf[offset]) / width : 0.5f)) / count;
+    };
+    int y, x;
+    float v = sampleCdf(marginalCdf.data(), kHeight, u2, y);
+    float u = sampleCdf(&conditionalCdf[size_t(y) * (kWidth + 1)], kWidth, u1, x);
+
+    float theta = v * glm::pi<float>();
+    float sinTheta = std::sin(theta);
+    if (sinTheta <= 0.0f)
+    {
+        return glm::vec3(0.0f, 1.0f, 0.0f);
+    }
+    float density = luminance(x, y) * std::sin((y + 0.5f) / kHeight * glm::pi<float>()) / marginalIntegral;
+    pdf = density / (2.0f * glm::pi<float>() * glm::pi<float>() * sinTheta);
+    return TexelDirection(u, v);
+}
+
+float EnvironmentMap::pdf(const glm::vec3 &dir) const
+{
+    if (marginalIntegral <= 0.0f)
+    {
+        return 0.0f;
+    }
+    int x, y;
+    float sinTheta;
+    DirectionToTexel(dir, x, y, sinTheta);
+    if (sinTheta <= 0.0f)
+    {
+        return 0.0f;
+    }
+    float density = luminance(x, y) * std::sin((y + 0.5f) / kHeight * glm::pi<float>()) / marginalIntegral;
+    return density / (2.0f * glm::pi<float>() * glm::pi<float>() * sinTheta);
+}
@@ -0,0 +1,146 @@
+#include "MemoryRegistry.hpp"
+#include "UICommon.hpp"
+
+#include <array>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace MemoryRegistry
+{
+    static constexpr size_t kCategoryCount = static_cast<size_t>(Category::Count);
+    static std::array<std::atomic<int64_t>, kCategoryCount> ReservedBytes{};
+    static std::array<std::atomic<int64_t>, kCategoryCount> UsedBytes{};
+
+    const char *CategoryName(Category category)
+    {
+        switch (category)
+        {
+        case Category::TriangleStorage:
+            return "TriangleStorage";
+        case Category::NodeStorage:
+            return "NodeStorage";
+        case Category::FlatTriangleStorage:
+            return "FlatTriangleStorage";
+        case Category::FlatNodeStorage:
+            return "FlatNodeStorage";
+        case Category::LegacyScene:
+            return "LegacyScene";
+        case Category::CPUImage:
+            return "CPUImage";
+        case Category::RadianceCache:
+            return "RadianceCache";
+        case Category::PathGuiding:
+            return "PathGuiding";
+        case Category::GLTexture:
+            return "GLTexture";
+        default:
+            return "Unknown";
+        }
+    }
+
+    void AddReserved(Category category, int64_t bytes)
+    {
+        ReservedBytes[static_cast<size_t>(category)].fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    void AddUsed(Category category, int64_t bytes)
+    {
+        UsedBytes[static_cast<size_t>(category)].fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    Usage GetUsage(Category category)
+    {
+        return Usage{
+            .reserved = ReservedBytes[static_cast<size_t>(category)].load(std::memory_order_relaxed),
+            .used = UsedBytes[static_cast<size_t>(category)].load(std::memory_order_relaxed)};
+    }
+
+    Usage GetTotalUsage()
+    {
+        Usage total;
+        for (size_t i = 0; i < kCategoryCount; ++i)
+        {
+            auto usage = GetUsage(static_cast<Category>(i));
+            total.reserved += usage.reserved;
+            total.used += usage.used;
+        }
+        return total;
+    }
+
+    std::string DumpJSON()
+    {
+        std::stringstream out;
+        out << "{\n";
+        for (size_t i = 0; i < kCategoryCount; ++i)
+        {
+            auto category = static_cast<Category>(i);
+            auto usage = GetUsage(category);
+            out << std::format("  \"{}\": {{\"reserved\": {}, \"used\": {}}},\n", CategoryName(category), usage.reserved, usage.used);
+        }
+        auto total = GetTotalUsage();
+        out << std::format("  \"Total\": {{\"reserved\": {}, \"used\": {}}}\n", total.reserved, total.used);
+        out << "}\n";
+        return out.str();
+    }
+
+    void DumpJSON(const std::string &path)
+    {
+        std::ofstream outfile(path);
+        if (!outfile.is_open())
+        {
+            throw std::runtime_error("Failed to write memory report to " + path);
+        }
+        outfile << DumpJSON();
+    }
+
+    void RenderUI()
+    {
+        auto toMB = [](int64_t bytes)
+        { return static_cast<double>(bytes) / (1024.0 * 1024.0); };
+
+        ImGui::Begin("Memory");
+        if (ImGui::BeginTable("MemoryRegistry", 3, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+        {
+            ImGui::TableSetupColumn("Subsystem");
+            ImGui::TableSetupColumn("Reserved (MB)");
+            ImGui::TableSetupColumn("Used (MB)");
+            ImGui::TableHeadersRow();
+            for (size_t i = 0; i < kCategoryCount; ++i)
+            {
+                auto category = static_cast<Category>(i);
+                auto usage = GetUsage(category);
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(CategoryName(category));
+                ImGui::TableNextColumn();
+                ImGui::Text("%.2f", toMB(usage.reserved));
+                ImGui::TableNextColumn();
+                ImGui::Text("%.2f", toMB(usage.used));
+            }
+            auto total = GetTotalUsage();
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted("Total");
+            ImGui::TableNextColumn();
+            ImGui::Text("%.2f", toMB(total.reserved));
+            ImGui::TableNextColumn();
+            ImGui::Text("%.2f", toMB(total.used));
+            ImGui::EndTable();
+        }
+        if (ImGui::Button("Dump Memory Report"))
+        {
+            try
+            {
+                DumpJSON("memory_report.json");
+            }
+            catch (std::exception &e)
+            {
+                std::cerr << e.what() << std::endl;
+            }
+        }
+        ImGui::End();
+    }
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "UICommon.hpp"
+#include "RenderState.hpp"
+#include "ArenaAllocator.hpp"
+
+class MemorySettings
+{
+public:
+    inline static void RenderUI()
+    {
+        ImGui::Begin("Memory");
+        {
+            ImGui::Text("NUMA Nodes: %d", Arena::NumaNodeCount());
+            // 放置策略只影响之后分配的页面, 需要重新加载场景才能作用于已有数据
+            ImGui::Checkbox("Huge Pages", &Arena::Settings::useHugePages);
+            static const char *policyNames[] = {"First Touch", "Interleave", "Bind", "Preferred"};
+            int policy = static_cast<int>(Arena::Settings::placementPolicy);
+            if (ImGui::Combo("Placement", &policy, policyNames, IM_ARRAYSIZE(policyNames)))
+            {
+                Arena::Settings::placementPolicy = static_cast<Arena::PlacementPolicy>(policy);
+            }
+            ImGui::DragInt("Bind Node", &Arena::Settings::bindNode, 1, 0, Arena::NumaNodeCount() - 1);
+            RenderState::SceneDirty |= ImGui::Checkbox("Replicate BVH Top Levels", &Arena::Settings::replicateTopLevels);
+            RenderState::SceneDirty |= ImGui::DragInt("Replicated Depth", &Arena::Settings::replicatedDepth, 1, 1, 32);
+        }
+        ImGui::End();
+    }
+};
@@ -14,6 +14,7 @@
 #include "Materials/Sky.hpp"
 #include "Random.hpp"
 #include "ModelLoader.hpp"
+#include "ArenaAllocator.hpp"
 
 void Scene::initialize()
 {
@@ -169,9 +170,9 @@ namespace SimplifiedData
     }
 
     Scene::Scene(const Scene &other)
+        : sceneIndices(other.sceneIndices), topLevelStart(other.topLevelStart)
     {
         pDataStorage = std::make_unique<sd::DataStorage>(*other.pDataStorage.get());
-        pDataStorage->rootIndex = other.pDataStorage->rootIndex;
     }
 
     Scene &Scene::operator=(const Scene &other)
@@ -180,10 +181,35 @@ namespace SimplifiedData
         {
             pDataStorage = std::make_unique<sd::DataStorage>(*other.pDataStorage.get());
             sceneIndices = other.sceneIndices;
+            topLevelStart = other.topLevelStart;
         }
         return *this;
     }
 
+    std::shared_ptr<const Scene> Scene::snapshot() const
+    {
+        auto scene = std::make_shared<Scene>(*this);
+        const int nodeCount = Arena::NumaNodeCount();
+        if (Arena::Settings::replicateTopLevels && nodeCount > 1)
+        {
+            for (int node = 0; node < nodeCount; ++node)
+            {
+                scene->numaReplicas.push_back(std::make_unique<const sd::DataStorage>(
+                    pDataStorage->replicateTopLevels(node, Arena::Settings::replicatedDepth)));
+            }
+        }
+        return scene;
+    }
+
+    const sd::DataStorage &Scene::storageForNode(int numaNode) const
+    {
+        if (numaNode >= 0 && numaNode < static_cast<int>(numaReplicas.size()))
+        {
+            return *numaReplicas[numaNode];
+        }
+        return *pDataStorage;
+    }
+
     void Scene::initialize()
     {
         ModelLoader::SetDataStorage(pDataStorage.get());
@@ -202,8 +228,10 @@ namespace SimplifiedData
             // root = sd::ModelLoader::LoadModelFileSync("Resources/TheStanfordDragon18520.obj");
             sceneIndices.push_back(root);
 
+            topLevelStart = pDataStorage->nodeStorage.nextIndex;
             auto sceneRoot = sd::BVH::BuildBVHFromNodes(pDataStorage->nodeStorage, sceneIndices.data(), 0, sceneIndices.size());
             pDataStorage->rootIndex = sceneRoot;
+            pDataStorage->lightTree.build(pDataStorage->triangleStorage, pDataStorage->emitters);
         }
         catch (std::exception &e)
         {
@@ -212,4 +240,26 @@ namespace SimplifiedData
         }
     }
 
+    void Scene::addAreaLight(const glm::vec3 &center, float size, const color4 &emission)
+    {
+        const float half = size * 0.5f;
+        const glm::vec3 normal(0.0f, -1.0f, 0.0f); // 朝下, 发光本身是双面的
+        std::vector<sd::Vertex> vertices = {
+            {center + glm::vec3(-half, 0.0f, -half), normal, glm::vec2(0.0f, 0.0f)},
+            {center + glm::vec3(half, 0.0f, -half), normal, glm::vec2(1.0f, 0.0f)},
+            {center + glm::vec3(half, 0.0f, half), normal, glm::vec2(1.0f, 1.0f)},
+            {center + glm::vec3(-half, 0.0f, half), normal, glm::vec2(0.0f, 1.0f)}};
+        std::vector<unsigned int> indices = {0, 1, 2, 0, 2, 3};
+        // 丢弃旧的顶层节点(快照持有的页面是写时复制的, 不受影响), 否则每次加灯都会泄漏一整棵顶层树
+        if (topLevelStart != sd::invalidIndex)
+        {
+            pDataStorage->nodeStorage.nextIndex = topLevelStart;
+        }
+        sd::Mesh mesh(*pDataStorage, vertices, indices, LightEmit(emission));
+        sceneIndices.push_back(mesh.meshNodeIndex);
+        topLevelStart = pDataStorage->nodeStorage.nextIndex;
+        pDataStorage->rootIndex = sd::BVH::BuildBVHFromNodes(pDataStorage->nodeStorage, sceneIndices.data(), 0, sceneIndices.size());
+        pDataStorage->lightTree.build(pDataStorage->triangleStorage, pDataStorage->emitters);
+    }
+
 }
\ No newline at end of file
@@ -8,6 +8,7 @@
 #include "BVH.hpp"
 #include "Materials.hpp"
 #include "SimplifiedData.hpp"
+#include "MemoryRegistry.hpp"
 
 // 全局静态场景类
 class Scene
@@ -15,51 +16,27 @@ class Scene
 public:
     std::vector<std::shared_ptr<Hittable>> objects;
     BVH BVHTree;
+    MemoryRegistry::Tracker memoryTracker{MemoryRegistry::Category::LegacyScene}; // 物体列表与顶层树, 网格数据由 MeshData 统计
 
     inline Scene()
     {
         initialize();
     }
     // 拷贝构造
+    // 物体以 shared_ptr 共享(网格数据不可变), BVH 叶子直接指向共享物体, 只需拷贝物体列表与顶层树
     inline Scene(const Scene &other)
         : objects(other.objects), BVHTree(other.BVHTree)
     {
-        if (other.BVHTree.root)
-        {
-            std::unordered_map<std::shared_ptr<Hittable>, int> indexHash;
-            for (int i = 0; i < objects.size(); ++i)
-            {
-                if (objects[i] != nullptr)
-                {
-                    indexHash[objects[i]] = i;
-                }
-            }
-            auto remapping = [this, &indexHash](auto &&traverseSelf, BVHNode *node) -> void
-            {
-                if (!node)
-                {
-                    return;
-                }
-                if (node->object) // 叶子节点
-                {
-                    node->object = objects[indexHash[node->object]];
-                }
-                traverseSelf(traverseSelf, node->left);
-                traverseSelf(traverseSelf, node->right);
-            };
-            remapping(remapping, BVHTree.root);
-
-            // BVHTree.build(objects);
-        }
+        updateMemoryUsage();
     }
     // 拷贝赋值
-    // 深拷贝场景 BVH
     inline Scene &operator=(const Scene &other)
     {
-        objects = other.objects;
-        if (other.BVHTree.root)
+        if (this != &other)
         {
-            BVHTree.build(objects);
+            objects = other.objects;
+            BVHTree = other.BVHTree;
+            updateMemoryUsage();
         }
         return *this;
     }
@@ -69,6 +46,15 @@ public:
     inline void update()
     {
         BVHTree.build(objects);
+        updateMemoryUsage();
+    }
+
+    inline void updateMemoryUsage()
+    {
+        size_t bvhBytes = BVHTree.nodeCount() * sizeof(BVHNode);
+        memoryTracker.set(
+            objects.capacity() * sizeof(std::shared_ptr<Hittable>) + bvhBytes,
+            objects.size() * sizeof(std::shared_ptr<Hittable>) + bvhBytes);
     }
 
     inline void addObject(std::shared_ptr<Hittable> object)
@@ -102,14 +88,25 @@ namespace SimplifiedData
     public:
         std::unique_ptr<sd::DataStorage> pDataStorage = nullptr;
         std::vector<uint32_t> sceneIndices;
+        // 顶层BVH节点在 nodeStorage 中的起始位置; 顶层节点总是最后加入的, 重建时退回这里覆盖旧节点
+        uint32_t topLevelStart = sd::invalidIndex;
+        // 每个NUMA节点一份顶层BVH本地副本, 只在快照中生成(Arena::Settings::replicateTopLevels)
+        std::vector<std::unique_ptr<const sd::DataStorage>> numaReplicas;
 
         Scene();
 
-        //拷贝
+        //拷贝 只拷贝存储页表, 网格数据与源场景共享(COW)
         Scene(const Scene &other) ;
         Scene &operator=(const Scene &other);
-        
+
+        // 生成不可变快照, 供渲染线程无锁读取. 调用方需持有场景读锁
+        std::shared_ptr<const Scene> snapshot() const;
+
+        // 渲染线程按所在NUMA节点选择存储, 无副本时返回主存储
+        const sd::DataStorage &storageForNode(int numaNode) const;
 
         void initialize(); // 布置场景 延迟初始化
+        // 在 center 处加入边长为 size 的水平正方形面光源并重建顶层BVH. 调用方需持有场景写锁
+        void addAreaLight(const glm::vec3 &center, float size, const color4 &emission);
     };
 }
\ No newline at end of file
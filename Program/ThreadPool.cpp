@@ -0,0 +1,340 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#elif defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#endif
+
+namespace
+{
+    thread_local ThreadPool *CurrentPool = nullptr;
+    thread_local size_t CurrentWorker = 0;
+
+    struct ProcessorTopology
+    {
+        std::vector<int> primary; // 每个物理核心的第一个逻辑处理器
+        std::vector<int> all;     // primary 之后接上其余 SMT 兄弟线程
+    };
+
+#if defined(__linux__)
+    // 进程启动时允许使用的处理器, 取消绑核时恢复到此集合
+    const cpu_set_t &ProcessAffinity()
+    {
+        static const cpu_set_t mask = []()
+        {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            if (sched_getaffinity(0, sizeof(set), &set) != 0)
+            {
+                for (unsigned i = 0; i < std::max(1u, std::thread::hardware_concurrency()); ++i)
+                {
+                    CPU_SET(i, &set);
+                }
+            }
+            return set;
+        }();
+        return mask;
+    }
+
+    ProcessorTopology QueryTopology()
+    {
+        ProcessorTopology topology;
+        std::vector<int> siblings;
+        const cpu_set_t &allowed = ProcessAffinity();
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        {
+            if (!CPU_ISSET(cpu, &allowed))
+            {
+                continue;
+            }
+            // thread_siblings_list 形如 "0,8" 或 "0-1", 第一个编号即该核心的第一个逻辑处理器
+            int first = cpu;
+            std::ifstream file("/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/thread_siblings_list");
+            if (file)
+            {
+                file >> first;
+            }
+            (first == cpu ? topology.primary : siblings).push_back(cpu);
+        }
+        topology.all = topology.primary;
+        topology.all.insert(topology.all.end(), siblings.begin(), siblings.end());
+        return topology;
+    }
+
+    void PinThread(std::thread &thread, int processor)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(processor, &set);
+        pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+    }
+
+    void UnpinThread(std::thread &thread)
+    {
+        pthread_setaffinity_np(thread.native_handle(), sizeof(cpu_set_t), &ProcessAffinity());
+    }
+
+#elif defined(_WIN32)
+    // 处理器编号为 组号 * 64 + 组内序号
+    ProcessorTopology QueryTopology()
+    {
+        ProcessorTopology topology;
+        std::vector<int> siblings;
+        DWORD length = 0;
+        GetLogicalProcessorInformationEx(RelationProcessorCore, nullptr, &length);
+        std::vector<char> buffer(length);
+        auto *info = reinterpret_cast<SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *>(buffer.data());
+        if (length > 0 && GetLogicalProcessorInformationEx(RelationProcessorCore, info, &length))
+        {
+            for (DWORD offset = 0; offset < length;)
+            {
+                auto *entry = reinterpret_cast<SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *>(buffer.data() + offset);
+                const GROUP_AFFINITY &group = entry->Processor.GroupMask[0];
+                bool first = true;
+                for (int bit = 0; bit < 64; ++bit)
+                {
+                    if (group.Mask & (KAFFINITY(1) << bit))
+                    {
+                        (first ? topology.primary : siblings).push_back(group.Group * 64 + bit);
+                        first = false;
+                    }
+                }
+                offset += entry->Size;
+            }
+        }
+        topology.all = topology.primary;
+        topology.all.insert(topology.all.end(), siblings.begin(), siblings.end());
+        return topology;
+    }
+
+    void PinThread(std::thread &thread, int processor)
+    {
+        GROUP_AFFINITY affinity = {};
+        affinity.Group = static_cast<WORD>(processor / 64);
+        affinity.Mask = KAFFINITY(1) << (processor % 64);
+        SetThreadGroupAffinity(thread.native_handle(), &affinity, nullptr);
+    }
+
+    void UnpinThread(std::thread &thread)
+    {
+        DWORD_PTR processMask = 0;
+        DWORD_PTR systemMask = 0;
+        if (GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask))
+        {
+            SetThreadAffinityMask(thread.native_handle(), processMask);
+        }
+    }
+
+#else
+    ProcessorTopology QueryTopology()
+    {
+        return ProcessorTopology{};
+    }
+
+    void PinThread(std::thread &, int) {}
+    void UnpinThread(std::thread &) {}
+#endif
+
+    const ProcessorTopology &Topology()
+    {
+        static const ProcessorTopology topology = []()
+        {
+            ProcessorTopology result = QueryTopology();
+            if (result.all.empty())
+            {
+                for (int i = 0; i < static_cast<int>(std::max(1u, std::thread::hardware_concurrency())); ++i)
+                {
+                    result.all.push_back(i);
+                }
+                result.primary = result.all;
+            }
+            return result;
+        }();
+        return topology;
+    }
+}
+
+ThreadPool::ThreadPool(size_t threadCount) : ThreadPool(Config{threadCount}) {}
+
+ThreadPool::ThreadPool(const Config &config)
+{
+    size_t threadCount = config.threadCount;
+    if (threadCount == 0)
+    {
+        threadCount = LogicalProcessors(true).size();
+    }
+    activeWorkers.store(threadCount, std::memory_order_relaxed);
+    queues.reserve(threadCount);
+    for (size_t i = 0; i < threadCount; ++i)
+    {
+        queues.push_back(std::make_unique<WorkerQueue>());
+    }
+    workers.reserve(threadCount);
+    for (size_t i = 0; i < threadCount; ++i)
+    {
+        workers.emplace_back([this, i]()
+                             { workerLoop(i); });
+    }
+    configure(config);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        stopping = true;
+    }
+    wakeCondition.notify_all();
+    for (auto &worker : workers)
+    {
+        if (worker.joinable())
+        {
+            worker.join();
+        }
+    }
+}
+
+ThreadPool &ThreadPool::Global()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+const std::vector<int> &ThreadPool::LogicalProcessors(bool useSMT)
+{
+    return useSMT ? Topology().all : Topology().primary;
+}
+
+void ThreadPool::configure(const Config &config)
+{
+    std::lock_guard<std::mutex> configLock(configMutex);
+    currentConfig = config;
+    size_t count = config.threadCount > 0 ? config.threadCount : LogicalProcessors(config.useSMT).size(); // 自动: 每个可用核心一个
+    activeWorkers.store(std::clamp<size_t>(count, 1, workers.size()), std::memory_order_relaxed);
+    applyAffinity();
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+    }
+    wakeCondition.notify_all(); // 新启用的线程需要醒来
+}
+
+// 第 i 个工作线程绑定到 LogicalProcessors 的第 i 个, 线程多于处理器时循环使用
+void ThreadPool::applyAffinity()
+{
+    const auto &processors = LogicalProcessors(currentConfig.useSMT);
+    for (size_t i = 0; i < workers.size(); ++i)
+    {
+        if (currentConfig.pinThreads && !processors.empty())
+        {
+            PinThread(workers[i], processors[i % processors.size()]);
+        }
+        else
+        {
+            UnpinThread(workers[i]);
+        }
+    }
+}
+
+void ThreadPool::push(Task task)
+{
+    const size_t active = concurrency();
+    size_t index = (CurrentPool == this)
+                       ? CurrentWorker
+                       : nextQueue.fetch_add(1, std::memory_order_relaxed) % active;
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->mutex);
+        queues[index]->tasks.push_back(std::move(task));
+    }
+    pendingTasks.fetch_add(1, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex); // 与等待方的谓词检查串行, 避免丢失唤醒
+    }
+    if (active < workers.size())
+    {
+        wakeCondition.notify_all(); // notify_one 可能唤醒休眠中的线程而丢失
+    }
+    else
+    {
+        wakeCondition.notify_one();
+    }
+}
+
+bool ThreadPool::popLocal(size_t index, Task &task)
+{
+    auto &queue = *queues[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty())
+    {
+        return false;
+    }
+    task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    return true;
+}
+
+bool ThreadPool::steal(size_t thief, Task &task)
+{
+    const size_t count = queues.size();
+    for (size_t offset = 1; offset <= count; ++offset)
+    {
+        auto &queue = *queues[(thief + offset) % count];
+        std::unique_lock<std::mutex> lock(queue.mutex, std::try_to_lock);
+        if (!lock.owns_lock() || queue.tasks.empty())
+        {
+            continue;
+        }
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        return true;
+    }
+    return false;
+}
+
+bool ThreadPool::tryRunOne()
+{
+    Task task;
+    bool found = (CurrentPool == this)
+                     ? (popLocal(CurrentWorker, task) || steal(CurrentWorker, task))
+                     : steal(nextQueue.load(std::memory_order_relaxed) % queues.size(), task);
+    if (!found)
+    {
+        return false;
+    }
+    pendingTasks.fetch_sub(1, std::memory_order_relaxed);
+    task();
+    return true;
+}
+
+void ThreadPool::workerLoop(size_t index)
+{
+    CurrentPool = this;
+    CurrentWorker = index;
+    // 序号不小于 concurrency() 的线程休眠, 停止时全部线程参与清空队列
+    bool draining = false;
+    auto enabled = [this, index]()
+    { return index < activeWorkers.load(std::memory_order_relaxed); };
+    while (true)
+    {
+        if ((draining || enabled()) && tryRunOne())
+        {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        wakeCondition.wait(lock, [&]()
+                           { return stopping || (enabled() && pendingTasks.load(std::memory_order_acquire) > 0); });
+        if (stopping && pendingTasks.load(std::memory_order_acquire) == 0)
+        {
+            return;
+        }
+        draining = stopping;
+    }
+}
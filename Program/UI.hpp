@@ -1,8 +1,11 @@
 #pragma once
+#include <atomic>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include "UICommon.hpp"
 #include "RenderState.hpp"
+#include "Random.hpp"
+#include "EnvironmentMap.hpp"
 
 class SkySettings
 {
@@ -75,3 +78,117 @@ public:
         shaders.setUniform("sunlightColor", SkySettings::sunlightColor*SkySettings::sunlightIntensity);
     }
 };
+
+// CPU 追踪的采样设置
+class SamplingSettings
+{
+public:
+    inline static bool useTimeBudget = true;  // 按时间预算决定每遍的采样数
+    inline static float frameBudgetMs = 33.f; // 每遍的目标耗时
+    inline static int maxSamplesPerPass = 64; // 每遍每像素采样数上限
+    inline static bool adaptive = true;         // 按块误差分配采样, 收敛的块停止追踪
+    inline static float errorThreshold = 0.01f; // 块内像素均值相对标准误差的收敛阈值
+    inline static int minSamples = 16;          // 估计误差前每个像素至少需要的采样数
+    inline static bool showConvergence = false; // 收敛状态调试叠加
+    inline static bool progressivePreview = true; // 重置后先以低分辨率预览
+    inline static int stillFrames = 8;            // 相机静止多少帧后开始全分辨率累计
+    inline static bool temporalReprojection = true; // 相机移动后重投影已累计的采样
+    inline static float historyWeight = 0.5f;       // 重投影像素保留的采样数比例
+    inline static float depthTolerance = 0.02f;     // 命中距离的相对容差, 超出视为遮挡变化
+    inline static bool nextEventEstimation = true;  // 漫反射命中时直接采样发光三角形, 与 BSDF 采样按 MIS 合并
+    inline static int lightSelection = 1;           // Trace::LightSelection, 默认按 light BVH
+    inline static bool russianRoulette = true;      // sd 路径按吞吐量做俄罗斯轮盘
+    inline static int rouletteMinDepth = 3;         // 前几段路径不做轮盘
+    inline static bool restir = false;              // 主光线命中点的直接光照使用蓄水池重采样, 每遍仅第一个采样
+    inline static int restirCandidates = 16;        // 每像素的初始候选数
+    inline static bool restirTemporal = true;       // 并入上一遍同一表面点的蓄水池
+    inline static int restirHistoryLimit = 20;      // 时域蓄水池的 M 上限, 为本遍候选数的倍数
+    inline static int restirSpatialNeighbors = 3;   // 空域复用的邻域像素数
+    inline static float restirSpatialRadius = 16.f; // 空域复用的半径(像素)
+    inline static bool radianceCache = false;        // 漫反射弹射后在世界空间辐射缓存处结束路径
+    inline static int radianceCacheBounce = 1;       // 第几次漫反射弹射之后查询缓存
+    inline static float radianceCacheCellSize = 0.05f; // 相机附近的缓存单元边长
+    inline static bool pathGuiding = false;          // 漫反射弹射按在线训练的 SD 树引导
+    inline static float guidingBsdfFraction = 0.5f;  // 引导时按 BSDF 采样的比例
+
+    // 每遍实际情况, 由追踪线程写入, 仅用于显示
+    inline static std::atomic<int> lastSamplesPerPass = 1;
+    inline static std::atomic<float> sampleCostNs = 0.f; // 每像素每采样耗时
+    inline static std::atomic<int> convergedTiles = 0;
+    inline static std::atomic<int> totalTiles = 0;
+    inline static std::atomic<float> reprojectedRatio = 0.f; // 最近一次重置时沿用历史的像素比例
+    inline static std::atomic<int> radianceCacheEntries = 0;
+    inline static std::atomic<int> guidingIteration = 0;
+    inline static std::atomic<int> guidingLeaves = 0;
+
+    inline static void RenderUI()
+    {
+        ImGui::Begin("CPU Sampling");
+        {
+            ImGui::Checkbox("Time Budget", &useTimeBudget);
+            ImGui::DragFloat("Budget (ms)", &frameBudgetMs, 1.f, 1.f, 1000.f);
+            ImGui::DragInt("Max spp / Pass", &maxSamplesPerPass, 1, 1, 1024);
+            ImGui::Text("spp / Pass: %d", lastSamplesPerPass.load());
+            ImGui::Text("Sample Cost: %.1f ns", sampleCostNs.load());
+            static const char *samplerNames[] = {"Independent", "Sobol (Owen)"};
+            int samplerIndex = static_cast<int>(Random::samplerType);
+            if (ImGui::Combo("Sampler", &samplerIndex, samplerNames, IM_ARRAYSIZE(samplerNames)))
+            {
+                Random::samplerType = static_cast<Random::SamplerType>(samplerIndex);
+                RenderState::Dirty = true; // 不同采样器的样本不能混合累计
+            }
+            if (ImGui::Checkbox("Blue Noise", &Random::blueNoise))
+            {
+                RenderState::Dirty = true;
+            }
+            RenderState::Dirty |= ImGui::Checkbox("Next Event Estimation", &nextEventEstimation);
+            static const char *lightSelectionNames[] = {"Area", "Light BVH"};
+            RenderState::Dirty |= ImGui::Combo("Light Selection", &lightSelection, lightSelectionNames, IM_ARRAYSIZE(lightSelectionNames));
+            bool skyImportanceSampling = EnvironmentMap::importanceSampling.load(std::memory_order_relaxed);
+            if (ImGui::Checkbox("Sky Importance Sampling", &skyImportanceSampling))
+            {
+                EnvironmentMap::importanceSampling.store(skyImportanceSampling, std::memory_order_relaxed);
+                RenderState::Dirty = true;
+            }
+            RenderState::Dirty |= ImGui::Checkbox("Russian Roulette", &russianRoulette);
+            RenderState::Dirty |= ImGui::SliderInt("Roulette Min Depth", &rouletteMinDepth, 1, 8);
+
+            ImGui::Separator();
+            RenderState::Dirty |= ImGui::Checkbox("ReSTIR Direct Lighting", &restir);
+            RenderState::Dirty |= ImGui::DragInt("Candidates", &restirCandidates, 1, 1, 256);
+            RenderState::Dirty |= ImGui::Checkbox("Temporal Reuse", &restirTemporal);
+            RenderState::Dirty |= ImGui::DragInt("History Limit", &restirHistoryLimit, 1, 1, 100);
+            RenderState::Dirty |= ImGui::DragInt("Spatial Neighbors", &restirSpatialNeighbors, 1, 0, 16);
+            RenderState::Dirty |= ImGui::DragFloat("Spatial Radius", &restirSpatialRadius, 0.5f, 1.f, 64.f);
+
+            ImGui::Separator();
+            RenderState::Dirty |= ImGui::Checkbox("Radiance Cache", &radianceCache);
+            RenderState::Dirty |= ImGui::SliderInt("Cache After Bounce", &radianceCacheBounce, 1, 2);
+            RenderState::Dirty |= ImGui::DragFloat("Cache Cell Size", &radianceCacheCellSize, 1e-3f, 1e-3f, 10.f, "%.3f");
+            ImGui::Text("Cache Entries: %d", radianceCacheEntries.load());
+
+            ImGui::Separator();
+            RenderState::Dirty |= ImGui::Checkbox("Path Guiding", &pathGuiding);
+            RenderState::Dirty |= ImGui::SliderFloat("Guiding BSDF Fraction", &guidingBsdfFraction, 0.05f, 1.f);
+            ImGui::Text("Guiding Iteration: %d, Leaves: %d", guidingIteration.load(), guidingLeaves.load());
+
+            ImGui::Separator();
+            ImGui::Checkbox("Adaptive", &adaptive);
+            ImGui::DragFloat("Error Threshold", &errorThreshold, 1e-4f, 1e-4f, 1.f, "%.4f");
+            ImGui::DragInt("Min Samples", &minSamples, 1, 2, 4096);
+            ImGui::Checkbox("Show Convergence", &showConvergence);
+
+            ImGui::Separator();
+            ImGui::Checkbox("Progressive Preview", &progressivePreview);
+            ImGui::DragInt("Still Frames", &stillFrames, 1, 0, 120);
+
+            ImGui::Separator();
+            ImGui::Checkbox("Temporal Reprojection", &temporalReprojection);
+            ImGui::DragFloat("History Weight", &historyWeight, 0.01f, 0.f, 1.f);
+            ImGui::DragFloat("Depth Tolerance", &depthTolerance, 1e-3f, 0.f, 1.f, "%.3f");
+            ImGui::Text("Reprojected: %.1f%%", reprojectedRatio.load() * 100.f);
+            ImGui::Text("Converged Tiles: %d / %d", convergedTiles.load(), totalTiles.load());
+        }
+        ImGui::End();
+    }
+};
@@ -3,6 +3,10 @@
 #include <filesystem>
 #include <chrono>
 #include <unordered_map>
+#include <atomic>
+#include <array>
+#include <algorithm>
+#include <cfloat>
 
 #include <Windows.h>
 #include <crtdbg.h>
@@ -138,6 +142,68 @@ namespace Profiler
         TimeBlocks[name].endTime = high_resolution_clock::now();
     }
 
+    namespace
+    {
+        constexpr int kPathEndCount = static_cast<int>(PathEnd::Count);
+        constexpr uint64_t kFlushInterval = 256;
+
+        std::atomic<uint64_t> PathLengths[kMaxTrackedPathLength + 1];
+        std::atomic<uint64_t> PathEnds[kPathEndCount];
+
+        struct LocalPathStats
+        {
+            uint64_t count = 0;
+            uint64_t lengths[kMaxTrackedPathLength + 1] = {};
+            uint64_t ends[kPathEndCount] = {};
+
+            void flush()
+            {
+                for (int i = 0; i <= kMaxTrackedPathLength; ++i)
+                {
+                    if (lengths[i] > 0)
+                    {
+                        PathLengths[i].fetch_add(lengths[i], std::memory_order_relaxed);
+                        lengths[i] = 0;
+                    }
+                }
+                for (int i = 0; i < kPathEndCount; ++i)
+                {
+                    if (ends[i] > 0)
+                    {
+                        PathEnds[i].fetch_add(ends[i], std::memory_order_relaxed);
+                        ends[i] = 0;
+                    }
+                }
+                count = 0;
+            }
+            ~LocalPathStats() { flush(); }
+        };
+        thread_local LocalPathStats LocalStats;
+    }
+
+    void RecordPath(int length, PathEnd end)
+    {
+        LocalStats.lengths[std::clamp(length, 0, kMaxTrackedPathLength)]++;
+        LocalStats.ends[static_cast<int>(end)]++;
+        if (++LocalStats.count >= kFlushInterval)
+        {
+            LocalStats.flush();
+        }
+    }
+
+    // 其他线程尚未并入的局部计数不受影响, 最多各 256 条
+    void ResetPathStats()
+    {
+        for (auto& length : PathLengths)
+        {
+            length.store(0, std::memory_order_relaxed);
+        }
+        for (auto& end : PathEnds)
+        {
+            end.store(0, std::memory_order_relaxed);
+        }
+    }
+
     void RenderUI()
     {
         ImGui::Begin("Profiler");
@@ -146,6 +212,30 @@ namespace Profiler
             auto duration = duration_cast<milliseconds>(timeBlock.endTime - timeBlock.startTime).count();
             ImGui::Text("%s: %lld ms", name.c_str(), duration);
         }
+
+        ImGui::Separator();
+        std::array<float, kMaxTrackedPathLength + 1> histogram{};
+        uint64_t paths = 0;
+        double lengthSum = 0.0;
+        for (int i = 0; i <= kMaxTrackedPathLength; ++i)
+        {
+            uint64_t n = PathLengths[i].load(std::memory_order_relaxed);
+            histogram[i] = static_cast<float>(n);
+            paths += n;
+            lengthSum += static_cast<double>(n) * i;
+        }
+        ImGui::Text("Paths: %llu, Mean Length: %.2f", static_cast<unsigned long long>(paths), paths > 0 ? lengthSum / paths : 0.0);
+        ImGui::PlotHistogram("Path Length", histogram.data(), static_cast<int>(histogram.size()), 0, nullptr, 0.0f, FLT_MAX, ImVec2(0, 60));
+        static const char* endNames[kPathEndCount] = {"Emitter", "Sky", "Absorbed", "Cache", "Roulette", "Bounce Limit"};
+        for (int i = 0; i < kPathEndCount; ++i)
+        {
+            uint64_t n = PathEnds[i].load(std::memory_order_relaxed);
+            ImGui::Text("%s: %.1f%%", endNames[i], paths > 0 ? 100.0 * static_cast<double>(n) / static_cast<double>(paths) : 0.0);
+        }
+        if (ImGui::Button("Reset Path Stats"))
+        {
+            ResetPathStats();
+        }
         ImGui::End();
     }
 
@@ -53,20 +53,24 @@ void LoadSdSceneGPU::resizeTextureStroage(TextureStorage &texLoading, const Flat
 // LoadSdSceneCPU
 LoadSdSceneCPU::LoadSdSceneCPU(SdSceneCPUContext &context) : DIContext(context) {}
 void LoadSdSceneCPU::load() {
+    std::shared_ptr<const sd::Scene> snapshot;
     {
-        std::unique_lock<std::shared_mutex> sceneWriteLock(*DIContext.sceneRenderingMutex); // write lock
-        std::shared_lock<std::shared_mutex> sceneReadLock(Storage::SdSceneMutex);           // read lock
-        DIContext.sceneRendering = std::make_unique<sd::Scene>(Storage::SdScene);           // 拷贝上传数据
+        std::shared_lock<std::shared_mutex> sceneReadLock(Storage::SdSceneMutex); // read lock
+        snapshot = Storage::SdScene.snapshot();                                  // 只拷贝页表, 网格数据共享
     }
+    DIContext.sceneRendering->publish(std::move(snapshot)); // 原子替换, 正在渲染的帧继续使用旧快照
 }
 
 // LoadSceneCPU
 LoadSceneCPU::LoadSceneCPU(SceneCPUContext &context) : DIContext(context) {}
 void LoadSceneCPU::load() {
     try {
-        std::unique_lock<std::shared_mutex> sceneWriteLock(*DIContext.sceneRenderingMutex); // write lock
-        std::shared_lock<std::shared_mutex> sceneReadLock(Storage::OldSceneMutex);          // read lock
-        DIContext.sceneRendering = std::make_unique<Scene>(Storage::OldScene);              // 拷贝上传数据
+        std::shared_ptr<const Scene> snapshot;
+        {
+            std::shared_lock<std::shared_mutex> sceneReadLock(Storage::OldSceneMutex); // read lock
+            snapshot = std::make_shared<const Scene>(Storage::OldScene);              // 物体共享, 只拷贝顶层树
+        }
+        DIContext.sceneRendering->publish(std::move(snapshot));
     } catch (std::exception &e) {
         std::cerr << "Error loading Old Scene: " << e.what() << std::endl;
     }
@@ -17,8 +17,8 @@ private:
     void resizeTextureStroage(TextureStorage &texLoading, const FlatStorage &flatStorage, const std::string &storageName);
 };
 
-//[全局变量访问]: Storage::SdScene.pDataStorage
-
+//[全局变量访问]: Storage::SdScene
+//               Storage::SdSceneMutex
 class LoadSdSceneCPU : public ILoadMethod
 {
     SdSceneCPUContext &DIContext;
@@ -30,16 +30,15 @@ struct SdSceneGPUContext // 将被移动注入
 
 struct SdSceneCPUContext // 将被移动注入
 {
-    std::unique_ptr<sd::Scene> sceneRendering; // CPU Context Loader 上传目标, Trace 读取目标
-    std::unique_ptr<std::shared_mutex> sceneRenderingMutex; // 必须是指针，不能移动锁
+    // CPU Context Loader 发布目标, Trace 每帧 pin 一次快照
+    std::unique_ptr<Storage::SnapshotPublisher<sd::Scene>> sceneRendering; // 必须是指针，不能移动原子量
 
     Camera &cam;
 
     // 通过构造函数区别注入的依赖和内部创建的依赖
     SdSceneCPUContext(
         Camera &_cam)
-        : sceneRendering(std::make_unique<sd::Scene>()),
-          sceneRenderingMutex(std::make_unique<std::shared_mutex>()),
+        : sceneRendering(std::make_unique<Storage::SnapshotPublisher<sd::Scene>>()),
           cam(_cam)
     {
     }
@@ -47,16 +46,15 @@ struct SdSceneCPUContext // 将被移动注入
 
 struct SceneCPUContext // 将被移动注入
 {
-    std::unique_ptr<Scene> sceneRendering; // CPU Context Loader 上传目标, Trace 读取目标
-    std::unique_ptr<std::shared_mutex> sceneRenderingMutex; // 必须是指针，不能移动锁
+    // CPU Context Loader 发布目标, Trace 每帧 pin 一次快照
+    std::unique_ptr<Storage::SnapshotPublisher<Scene>> sceneRendering; // 必须是指针，不能移动原子量
 
     Camera &cam;
 
     // 通过构造函数区别注入的依赖和内部创建的依赖
     SceneCPUContext(
         Camera &_cam)
-        : sceneRendering(std::make_unique<Scene>()),
-          sceneRenderingMutex(std::make_unique<std::shared_mutex>()),
+        : sceneRendering(std::make_unique<Storage::SnapshotPublisher<Scene>>()),
           cam(_cam)
     {
     }
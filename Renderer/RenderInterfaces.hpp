@@ -11,6 +11,24 @@ public:
     virtual ~ITraceMethod() {}
 };
 
+// 可异步执行的追踪方法: 计算与GL上传分离, 由 Tracer 在后台执行计算
+// prepare 与 present 在GL线程调用, execute 在后台线程调用且不得访问GL.
+// Tracer 保证三者不会并发: 一遍 execute 结束之前不会再次 prepare 或 present
+class IAsyncTraceMethod : public ITraceMethod
+{
+public:
+    /// 记录本遍所需的状态(相机, 场景快照, 分辨率), sampleCount 为本遍第一个采样的序号(从1开始)
+    /// previewScale > 1 时本遍为低分辨率预览(每 previewScale x previewScale 像素一个采样), 结果不计入累计
+    /// 返回本遍每像素的采样数, 0 表示本遍无事可做
+    virtual int prepare(const Texture2D &traceInput, int sampleCount, int previewScale) = 0;
+    /// 计算一遍采样, 累计到内部图像
+    virtual void execute() = 0;
+    /// 将最近一次完成的累计结果上传到 traceOutput
+    virtual void present(Texture2D &traceOutput) = 0;
+    /// 请求中止进行中的 execute, 可在任意线程调用; execute 在当前块完成后返回, 图像中只有部分块是本遍结果
+    virtual void cancel() = 0;
+};
+
 //规定 方法必须保证线程安全
 class ILoadMethod
 {
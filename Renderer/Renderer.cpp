@@ -3,6 +3,7 @@
 #include "LoaderImpl.hpp"
 #include "PostProcessor.hpp"
 #include "SkyTexPass.hpp"
+#include "EnvironmentMap.hpp"
 #include "RenderState.hpp"
 #include "Storage.hpp"
 #include "RenderContexts.hpp"
@@ -65,11 +66,12 @@ void Renderer::render()
 {
     assert(currentPipeline && "RenderPipeline not set in Renderer::render");
     // 对pipeline context的绑定修改不需要同步?句柄引用?
-    tracer->waitForCompletion(); // 帧同步
+    // CPU追踪在后台逐遍进行, 这里不等待; tracer->render 在一遍完成时上传结果并开始下一遍
     uploader->waitForCompletion();
     // Preprocessing
     skyTexPass->render(cam.position);
     skyboxTextureID = skyTexPass->getCubemap();
+    EnvironmentMap::Update(); // CPU 追踪的天空表, 参数改变时后台重建
     // 需要注入到GPU渲染管线
 
     auto loadMethod = currentPipeline->getLoadMethod();
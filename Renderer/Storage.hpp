@@ -1,5 +1,7 @@
 #pragma once
 
+#include <atomic>
+#include <memory>
 #include <thread>
 #include <shared_mutex>
 #include <condition_variable>
@@ -33,6 +35,25 @@ namespace Storage
         }
     };
 
+    // 不可变快照发布点
+    // 写者构造新快照后原子替换, 读者每帧 pin 一次得到引用计数的快照, 读取期间无需加锁.
+    // 旧快照在最后一个读者释放后析构
+    template <typename T>
+    class SnapshotPublisher
+    {
+        std::atomic<std::shared_ptr<const T>> current;
+
+    public:
+        inline void publish(std::shared_ptr<const T> snapshot)
+        {
+            current.store(std::move(snapshot), std::memory_order_release);
+        }
+        inline std::shared_ptr<const T> pin() const
+        {
+            return current.load(std::memory_order_acquire);
+        }
+    };
+
     extern SceneBundle SceneBundleRendering;
     extern std::shared_mutex SceneBundleRenderingMutex;
     extern sd::Scene SdScene;
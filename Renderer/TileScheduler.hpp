@@ -0,0 +1,302 @@
+#pragma once
+#include "ThreadPool.hpp"
+#include "UICommon.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// CPU帧的分块调度
+// 画面切成小块, 工作任务从共享计数器动态领取下一块, 耗时长的区域(例如模型覆盖的区域)不会拖住其他线程.
+// 块的顺序沿 Hilbert 曲线(相邻块空间连续, 缓存友好) 或从屏幕中心向外螺旋(先看到画面主体).
+// Bands 为旧的按线程数横向切条方式, 保留用于对比负载不均衡度.
+enum class TileOrder
+{
+    Bands,
+    Scanline,
+    Hilbert,
+    Spiral
+};
+
+struct Tile
+{
+    uint32_t x0, y0; // 包含
+    uint32_t x1, y1; // 不包含
+    uint32_t index = 0; // 在块列表中的序号, 用于索引按块保存的状态
+};
+
+// 一帧的负载统计, 时间单位毫秒
+struct FrameLoadStats
+{
+    double wallTime = 0.0;      // 帧着色总耗时
+    double maxWorkerTime = 0.0; // 最忙的工作任务耗时
+    double meanWorkerTime = 0.0;
+    size_t tileCount = 0;
+    bool cancelled = false; // 被取消的帧只完成了部分块
+
+    // 最忙任务 / 平均任务, 1 表示完全均衡
+    inline double imbalance() const
+    {
+        return meanWorkerTime > 0.0 ? maxWorkerTime / meanWorkerTime : 1.0;
+    }
+};
+
+class TileSettings
+{
+    inline static std::mutex statsMutex;
+    inline static FrameLoadStats lastStats;
+    inline static double smoothedImbalance = 1.0;
+
+public:
+    inline static int tileSize = 16;
+    inline static TileOrder order = TileOrder::Hilbert;
+    // 全局线程池的工作线程设置, 0 表示每个可用核心一个
+    inline static int threadCount = 0;
+    inline static bool pinThreads = false;
+    inline static bool useSMT = true;
+
+    inline static void ReportFrame(const FrameLoadStats &stats)
+    {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        lastStats = stats;
+        smoothedImbalance = 0.9 * smoothedImbalance + 0.1 * stats.imbalance();
+    }
+
+    inline static void RenderUI()
+    {
+        ImGui::Begin("CPU Scheduling");
+        {
+            static const char *orderNames[] = {"Bands", "Scanline", "Hilbert", "Spiral"};
+            int orderIndex = static_cast<int>(order);
+            if (ImGui::Combo("Tile Order", &orderIndex, orderNames, IM_ARRAYSIZE(orderNames)))
+            {
+                order = static_cast<TileOrder>(orderIndex);
+            }
+            ImGui::DragInt("Tile Size", &tileSize, 1, 4, 128);
+
+            ThreadPool &pool = ThreadPool::Global();
+            bool threadsChanged = ImGui::SliderInt("Threads (0 = Auto)", &threadCount, 0, static_cast<int>(pool.size()));
+            threadsChanged |= ImGui::Checkbox("Pin Threads", &pinThreads);
+            threadsChanged |= ImGui::Checkbox("SMT", &useSMT);
+            if (threadsChanged)
+            {
+                pool.configure(ThreadPool::Config{static_cast<size_t>(std::max(threadCount, 0)), pinThreads, useSMT});
+            }
+            ImGui::Text("Workers: %zu / %zu (cores %zu)", pool.concurrency(), pool.size(), ThreadPool::LogicalProcessors(false).size());
+
+            std::lock_guard<std::mutex> lock(statsMutex);
+            ImGui::Text("Tiles: %zu", lastStats.tileCount);
+            ImGui::Text("Frame: %.2f ms", lastStats.wallTime);
+            ImGui::Text("Worker max/mean: %.2f / %.2f ms", lastStats.maxWorkerTime, lastStats.meanWorkerTime);
+            ImGui::Text("Imbalance: %.3f (avg %.3f)", lastStats.imbalance(), smoothedImbalance);
+        }
+        ImGui::End();
+    }
+};
+
+class TileScheduler
+{
+    std::vector<Tile> tiles;
+    size_t cachedWidth = 0;
+    size_t cachedHeight = 0;
+    int cachedTileSize = 0;
+    TileOrder cachedOrder = TileOrder::Bands;
+    size_t cachedBands = 0;
+    uint64_t generation = 0; // 块列表每次重建加一
+
+    // Hilbert 曲线上第 d 个点的坐标, n 为2的幂
+    inline static void HilbertD2XY(uint32_t n, uint32_t d, uint32_t &x, uint32_t &y)
+    {
+        x = y = 0;
+        for (uint32_t s = 1; s < n; s *= 2)
+        {
+            uint32_t rx = 1 & (d / 2);
+            uint32_t ry = 1 & (d ^ rx);
+            if (ry == 0)
+            {
+                if (rx == 1)
+                {
+                    x = s - 1 - x;
+                    y = s - 1 - y;
+                }
+                std::swap(x, y);
+            }
+            x += s * rx;
+            y += s * ry;
+            d /= 4;
+        }
+    }
+
+    inline void build(size_t width, size_t height, uint32_t size, TileOrder order, size_t bands)
+    {
+        tiles.clear();
+        if (width == 0 || height == 0)
+        {
+            return;
+        }
+        if (order == TileOrder::Bands)
+        {
+            size_t rowsPerBand = height / bands;
+            for (size_t i = 0; i < bands; ++i)
+            {
+                uint32_t y0 = static_cast<uint32_t>(i * rowsPerBand);
+                uint32_t y1 = (i == bands - 1) ? static_cast<uint32_t>(height) : static_cast<uint32_t>(y0 + rowsPerBand);
+                if (y1 > y0)
+                {
+                    tiles.push_back(Tile{0, y0, static_cast<uint32_t>(width), y1});
+                }
+            }
+            return;
+        }
+
+        const uint32_t tilesX = static_cast<uint32_t>((width + size - 1) / size);
+        const uint32_t tilesY = static_cast<uint32_t>((height + size - 1) / size);
+        auto makeTile = [&](uint32_t tx, uint32_t ty)
+        {
+            return Tile{tx * size, ty * size,
+                        std::min(static_cast<uint32_t>(width), (tx + 1) * size),
+                        std::min(static_cast<uint32_t>(height), (ty + 1) * size)};
+        };
+        tiles.reserve(size_t(tilesX) * tilesY);
+        switch (order)
+        {
+        case TileOrder::Hilbert:
+        {
+            uint32_t n = 1;
+            while (n < std::max(tilesX, tilesY))
+            {
+                n *= 2;
+            }
+            for (uint32_t d = 0; d < n * n; ++d)
+            {
+                uint32_t tx, ty;
+                HilbertD2XY(n, d, tx, ty);
+                if (tx < tilesX && ty < tilesY)
+                {
+                    tiles.push_back(makeTile(tx, ty));
+                }
+            }
+            break;
+        }
+        case TileOrder::Spiral:
+        {
+            for (uint32_t ty = 0; ty < tilesY; ++ty)
+            {
+                for (uint32_t tx = 0; tx < tilesX; ++tx)
+                {
+                    tiles.push_back(makeTile(tx, ty));
+                }
+            }
+            // 按到画面中心的环数排序, 同一环内按角度排序
+            const float cx = width * 0.5f;
+            const float cy = height * 0.5f;
+            auto key = [&](const Tile &tile)
+            {
+                float dx = (tile.x0 + tile.x1) * 0.5f - cx;
+                float dy = (tile.y0 + tile.y1) * 0.5f - cy;
+                int ring = static_cast<int>(std::max(std::abs(dx), std::abs(dy)) / size);
+                return std::make_pair(ring, std::atan2(dy, dx));
+            };
+            std::stable_sort(tiles.begin(), tiles.end(), [&](const Tile &a, const Tile &b)
+                             { return key(a) < key(b); });
+            break;
+        }
+        default:
+            for (uint32_t ty = 0; ty < tilesY; ++ty)
+            {
+                for (uint32_t tx = 0; tx < tilesX; ++tx)
+                {
+                    tiles.push_back(makeTile(tx, ty));
+                }
+            }
+            break;
+        }
+    }
+
+public:
+    // 按当前设置准备块列表, 尺寸与设置不变时复用
+    inline const std::vector<Tile> &prepare(size_t width, size_t height, size_t bands)
+    {
+        const int size = std::max(TileSettings::tileSize, 1);
+        const TileOrder order = TileSettings::order;
+        if (width != cachedWidth || height != cachedHeight || size != cachedTileSize || order != cachedOrder || bands != cachedBands)
+        {
+            build(width, height, static_cast<uint32_t>(size), order, std::max<size_t>(bands, 1));
+            for (size_t i = 0; i < tiles.size(); ++i)
+            {
+                tiles[i].index = static_cast<uint32_t>(i);
+            }
+            ++generation;
+            cachedWidth = width;
+            cachedHeight = height;
+            cachedTileSize = size;
+            cachedOrder = order;
+            cachedBands = bands;
+        }
+        return tiles;
+    }
+
+    // 按块保存状态的使用方据此判断块列表是否已重建
+    inline uint64_t tileGeneration() const { return generation; }
+
+    // 按当前设置准备块列表并着色一帧
+    template <typename F>
+    inline FrameLoadStats run(ThreadPool &pool, size_t width, size_t height, F &&shadeTile, const CancellationToken *token = nullptr)
+    {
+        return run(pool, prepare(width, height, pool.concurrency()), std::forward<F>(shadeTile), token);
+    }
+
+    // 在线程池上着色一帧, 每个工作任务循环领取下一块直到领完; shadeTile(const Tile&) 可被并发调用
+    // 每领取一块前检查 token, 取消后在各线程当前块结束时返回
+    // frameTiles 由调用方固定, 着色期间修改块大小, 顺序或线程数不会改变本帧的块
+    template <typename F>
+    inline FrameLoadStats run(ThreadPool &pool, const std::vector<Tile> &frameTiles, F &&shadeTile, const CancellationToken *token = nullptr)
+    {
+        using Clock = std::chrono::steady_clock;
+        const size_t numWorkers = std::max<size_t>(pool.concurrency(), 1);
+        std::atomic<size_t> nextTile{0};
+        std::vector<double> workerTimes(numWorkers, 0.0);
+
+        auto frameStart = Clock::now();
+        {
+            TaskGroup group(pool);
+            for (size_t worker = 0; worker < numWorkers; ++worker)
+            {
+                group.run([&, worker]()
+                          {
+                              auto start = Clock::now();
+                              for (size_t i = nextTile.fetch_add(1, std::memory_order_relaxed); i < frameTiles.size();
+                                   i = nextTile.fetch_add(1, std::memory_order_relaxed))
+                              {
+                                  if (token && token->isCancelled())
+                                  {
+                                      break;
+                                  }
+                                  shadeTile(frameTiles[i]);
+                              }
+                              workerTimes[worker] = std::chrono::duration<double, std::milli>(Clock::now() - start).count(); });
+            }
+            group.wait();
+        }
+
+        FrameLoadStats stats;
+        stats.wallTime = std::chrono::duration<double, std::milli>(Clock::now() - frameStart).count();
+        stats.tileCount = frameTiles.size();
+        for (double time : workerTimes)
+        {
+            stats.maxWorkerTime = std::max(stats.maxWorkerTime, time);
+            stats.meanWorkerTime += time;
+        }
+        stats.meanWorkerTime /= static_cast<double>(std::max<size_t>(numWorkers, 1));
+        stats.cancelled = token && token->isCancelled();
+        if (!stats.cancelled)
+        {
+            TileSettings::ReportFrame(stats);
+        }
+        return stats;
+    }
+};
@@ -1,17 +1,27 @@
 #include "TraceMethods.hpp"
 #include "Pass.hpp"
-#include <future>
+#include "ArenaAllocator.hpp"
+#include "ThreadPool.hpp"
+#include "TileScheduler.hpp"
 #include <stdexcept>
 #include <iostream>
 #include <shared_mutex>
 #include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
 #include <memory>
 
 // TraceSdSceneGPU
 TraceSdSceneGPU::TraceSdSceneGPU(SdSceneGPUContext &context)
     : DIContext(context),
       traceRenderTarget(1, 1),
-      traceShader("GLSL/screenQuad.vs", "GLSL/simpleRayTrace.fs") {}
+      traceShader("GLSL/screenQuad.vs", "GLSL/simpleRayTrace.fs") {
+    blueNoiseTex.setFilterMax(GL_NEAREST);
+    blueNoiseTex.setFilterMin(GL_NEAREST);
+    blueNoiseTex.generate(BlueNoise::kSize, BlueNoise::kSize, GL_RG32F, GL_RG, GL_FLOAT,
+                          const_cast<float *>(BlueNoise::Mask().data()), false);
+}
 
 void TraceSdSceneGPU::trace(const Texture2D &traceInput, Texture2D &traceOutput, int sampleCount) {
     traceRenderTarget.bind();
@@ -23,9 +33,14 @@ void TraceSdSceneGPU::trace(const Texture2D &traceInput, Texture2D &traceOutput,
     traceShader.setTextureAuto(traceInput.ID, GL_TEXTURE_2D, 0, "lastSample");
     traceShader.setUniform("width", traceInput.Width);
     traceShader.setUniform("height", traceInput.Height);
-    float rand = Random::randomFloats(Random::generator);
+    float rand = Random::UniformFloat();
     traceShader.setUniform("rand", rand);
     traceShader.setUniform("samplesCount", sampleCount);
+    uint32_t offsetX, offsetY;
+    BlueNoise::Offset(static_cast<uint32_t>(sampleCount), offsetX, offsetY);
+    traceShader.setUniform("useBlueNoise", Random::blueNoise ? 1 : 0);
+    traceShader.setUniform("blueNoiseOffset", glm::vec2(offsetX, offsetY));
+    traceShader.setTextureAuto(blueNoiseTex.ID, GL_TEXTURE_2D, 0, "blueNoiseTex");
     DIContext.cam.setToFragShader(traceShader, "cam");
     {
         std::shared_lock<std::shared_mutex> sceneLock(*DIContext.sceneBundleRenderingMutex);
@@ -40,80 +55,482 @@ void TraceSdSceneGPU::trace(const Texture2D &traceInput, Texture2D &traceOutput,
     traceRenderTarget.unbind();
 }
 
-// TraceSdSceneCPU
-TraceSdSceneCPU::TraceSdSceneCPU(SdSceneCPUContext &context) : DIContext(context) {}
-void TraceSdSceneCPU::trace(const Texture2D &traceInput, Texture2D &traceOutput, int sampleCount) {
+// PassSettings
+PassSettings PassSettings::Capture() {
+    PassSettings settings;
+    settings.sampler = Random::samplerType;
+    settings.blueNoise = Random::blueNoise;
+    settings.minSamples = static_cast<uint32_t>(std::max(SamplingSettings::minSamples, 2));
+    settings.historyWeight = std::clamp(SamplingSettings::historyWeight, 0.0f, 1.0f);
+    settings.depthTolerance = std::max(SamplingSettings::depthTolerance, 0.0f);
+    settings.path = Trace::PathSettings::Capture();
+    settings.radianceCache = SamplingSettings::radianceCache;
+    settings.pathGuiding = SamplingSettings::pathGuiding;
+    settings.restir = SamplingSettings::restir;
+    settings.restirTemporal = SamplingSettings::restirTemporal;
+    settings.restirCandidates = std::max(SamplingSettings::restirCandidates, 1);
+    settings.restirHistoryLimit = std::max(SamplingSettings::restirHistoryLimit, 1);
+    settings.restirSpatialNeighbors = std::max(SamplingSettings::restirSpatialNeighbors, 0);
+    settings.restirSpatialRadius = std::max(SamplingSettings::restirSpatialRadius, 1.0f);
+    return settings;
+}
+
+// TraceCPUBase
+int TraceCPUBase::prepare(const Texture2D &traceInput, int sampleCount, int previewScale) {
+    if (!pinScene()) {
+        return 0; // 场景尚未上传
+    }
+    passCam = cam;
+    passSettings = PassSettings::Capture();
+    cancellation.reset();
+    ++passIndex;
+    const bool resized = traceImageData.width != size_t(traceInput.Width) || traceImageData.height != size_t(traceInput.Height);
     traceImageData.resize(traceInput.Width, traceInput.Height);
-    auto shade = [this, sampleCount](CPUImageData &imageData, size_t x, size_t y) {
-        const float perturbStrength = 0.001f;
-        auto &pixelColor = imageData.pixelAt(x, y);
-        auto uv = imageData.uvAt(x, y);
-        Ray ray(
-            DIContext.cam.position,
-            DIContext.cam.getRayDirction(uv) + Random::RandomVector(perturbStrength));
-        if (!DIContext.sceneRendering) {
-            throw std::runtime_error("Scene is not loaded.");
+    if (resized) {
+        // resize 不重排已有像素, 旧的累计与历史都不能再用
+        traceImageData.clearStatistics();
+        hasHistory = false;
+    }
+    passPreviewScale = std::max(previewScale, 1);
+    if (passPreviewScale > 1) {
+        previewImageData.resize(
+            (traceImageData.width + passPreviewScale - 1) / passPreviewScale,
+            (traceImageData.height + passPreviewScale - 1) / passPreviewScale);
+        previewTiles = previewScheduler.prepare(previewImageData.width, previewImageData.height, ThreadPool::Global().concurrency());
+        return 1;
+    }
+    passTiles = tileScheduler.prepare(traceImageData.width, traceImageData.height, ThreadPool::Global().concurrency());
+    const auto &tiles = passTiles;
+    const bool reset = sampleCount <= 1;
+    passReproject = false;
+    if (reset) {
+        sampleEpoch = passIndex;
+        // 同一场景下只有相机改变时重投影历史, 其余情况(场景重载, 尺寸改变)丢弃
+        passReproject = SamplingSettings::temporalReprojection && hasHistory && historyScene == pinnedScene() &&
+                        historyCam.width == passCam.width && historyCam.height == passCam.height &&
+                        !(historyCam == passCam);
+        if (passReproject) {
+            reprojectCam = historyCam;
+        } else {
+            traceImageData.clearStatistics();
+        }
+        SamplingSettings::reprojectedRatio = 0.f;
+    }
+    historyCam = passCam;
+    historyScene = pinnedScene();
+    hasHistory = true;
+    if (reset || tileGeneration != tileScheduler.tileGeneration() || tileErrors.size() != tiles.size()) {
+        tileErrors.assign(tiles.size(), std::numeric_limits<float>::infinity());
+        tileSamples.assign(tiles.size(), 1);
+        tileGeneration = tileScheduler.tileGeneration();
+    }
+    if (planAdaptiveSamples(tiles) == 0) {
+        return 0; // 全部收敛, 追踪空闲
+    }
+    return passSamplesPerPixel;
+}
+
+// 块内像素相对误差的均值, 有像素未达到最少采样数时返回无穷大
+float TraceCPUBase::measureTileError(const Tile &tile) const {
+    const uint32_t minSamples = passSettings.minSamples;
+    float errorSum = 0.0f;
+    for (size_t y = tile.y0; y < tile.y1; ++y) {
+        for (size_t x = tile.x0; x < tile.x1; ++x) {
+            if (traceImageData.samplesAt(x, y) < minSamples) {
+                return std::numeric_limits<float>::infinity();
+            }
+            errorSum += traceImageData.relativeError(x, y);
+        }
+    }
+    size_t pixels = size_t(tile.x1 - tile.x0) * (tile.y1 - tile.y0);
+    return pixels > 0 ? errorSum / static_cast<float>(pixels) : 0.0f;
+}
+
+// 按单采样耗时估计, 在预算内尽量多采样
+int TraceCPUBase::chooseSamplesPerPixel(size_t activePixels) const {
+    const double pixels = static_cast<double>(activePixels);
+    if (!SamplingSettings::useTimeBudget || sampleCostEstimate <= 0.0 || pixels <= 0.0) {
+        return 1;
+    }
+    double fit = SamplingSettings::frameBudgetMs / (sampleCostEstimate * pixels);
+    return std::clamp(static_cast<int>(fit), 1, std::max(SamplingSettings::maxSamplesPerPass, 1));
+}
+
+// 决定本遍每块的采样数: 收敛的块跳过, 其余块按误差相对均值的比例分配, 返回需要追踪的像素数
+size_t TraceCPUBase::planAdaptiveSamples(const std::vector<Tile> &tiles) {
+    const bool adaptive = SamplingSettings::adaptive;
+    const int maxSamples = std::max(SamplingSettings::maxSamplesPerPass, 1);
+    auto tilePixels = [](const Tile &tile) { return size_t(tile.x1 - tile.x0) * (tile.y1 - tile.y0); };
+    auto converged = [&](size_t i) { return adaptive && tileErrors[i] < SamplingSettings::errorThreshold; };
+
+    size_t activePixels = 0;
+    size_t convergedTiles = 0;
+    double errorSum = 0.0;
+    size_t measuredTiles = 0;
+    for (const auto &tile : tiles) {
+        if (converged(tile.index)) {
+            ++convergedTiles;
+            continue;
+        }
+        activePixels += tilePixels(tile);
+        if (std::isfinite(tileErrors[tile.index])) {
+            errorSum += tileErrors[tile.index];
+            ++measuredTiles;
         }
-        std::shared_lock<std::shared_mutex> sceneLock(*DIContext.sceneRenderingMutex);
-        auto newColor = Trace::CastRay(ray, 0, *DIContext.sceneRendering->pDataStorage);
-        pixelColor = (pixelColor * static_cast<float>(sampleCount - 1.f) + newColor) / static_cast<float>(sampleCount);
-    };
-    size_t rowsPerThread = traceImageData.height / numThreads;
-    for (int i = 0; i < numThreads; ++i) {
-        size_t startY = i * rowsPerThread;
-        size_t endY = (i == numThreads - 1) ? traceImageData.height : startY + rowsPerThread;
-        this->shadingFutures.push_back(std::async(std::launch::async, [this, startY, endY, shade]() {
-            for (size_t y = startY; y < endY; ++y) {
-                for (size_t x = 0; x < traceImageData.width; ++x) {
-                    shade(this->traceImageData, x, y);
+    }
+    SamplingSettings::convergedTiles = static_cast<int>(convergedTiles);
+    SamplingSettings::totalTiles = static_cast<int>(tiles.size());
+
+    passSamplesPerPixel = chooseSamplesPerPixel(activePixels);
+    const double meanError = measuredTiles > 0 ? errorSum / measuredTiles : 0.0;
+    passTotalSamples = 0.0;
+    for (const auto &tile : tiles) {
+        int samples = passSamplesPerPixel;
+        if (converged(tile.index)) {
+            samples = 0;
+        } else if (adaptive && meanError > 0.0 && std::isfinite(tileErrors[tile.index])) {
+            double scaled = passSamplesPerPixel * tileErrors[tile.index] / meanError;
+            samples = std::clamp(static_cast<int>(std::lround(scaled)), 1, maxSamples);
+        }
+        tileSamples[tile.index] = samples;
+        passTotalSamples += static_cast<double>(samples) * tilePixels(tile);
+    }
+    return activePixels;
+}
+
+void TraceCPUBase::execute() {
+    if (passPreviewScale > 1) {
+        previewScheduler.run(ThreadPool::Global(), previewTiles, [this](const Tile &tile) {
+            shadeTile(tile);
+        }, &cancellation);
+        return;
+    }
+    if (passReproject) {
+        reprojectHistory();
+    }
+    beforeShading();
+    auto stats = tileScheduler.run(ThreadPool::Global(), passTiles, [this](const Tile &tile) {
+        shadeTile(tile);
+    }, &cancellation);
+    const double samples = passTotalSamples;
+    if (!stats.cancelled && samples > 0.0) {
+        double cost = stats.wallTime / samples;
+        sampleCostEstimate = sampleCostEstimate > 0.0 ? 0.8 * sampleCostEstimate + 0.2 * cost : cost;
+        SamplingSettings::lastSamplesPerPass = passSamplesPerPixel;
+        SamplingSettings::sampleCostNs = static_cast<float>(sampleCostEstimate * 1e6);
+    }
+}
+
+// 把累计图像从上一个相机重投影到本遍相机
+// 每个新像素沿未抖动的主光线求命中点, 投影回旧相机取最近的旧像素; 命中距离一致才沿用, 否则视为新露出的区域
+// 沿用的像素采样数按 historyWeight 衰减, 让新采样更快覆盖重投影误差
+void TraceCPUBase::reprojectHistory() {
+    const size_t width = traceImageData.width;
+    const size_t height = traceImageData.height;
+    reprojectScratch.resize(width, height);
+    reprojectScratch.clearStatistics();
+    const Camera &oldCam = reprojectCam;
+    const float weight = passSettings.historyWeight;
+    const float tolerance = passSettings.depthTolerance;
+    std::atomic<size_t> accepted{0};
+    {
+        TaskGroup group(ThreadPool::Global());
+        const size_t rowsPerTask = 8;
+        for (size_t row = 0; row < height; row += rowsPerTask) {
+            group.run([&, row]() {
+                size_t localAccepted = 0;
+                for (size_t y = row; y < std::min(height, row + rowsPerTask); ++y) {
+                    for (size_t x = 0; x < width; ++x) {
+                        glm::vec3 dir = passCam.getRayDirction(traceImageData.uvAt(x, y));
+                        float depth = primaryHitDistance(Ray(passCam.position, dir));
+                        reprojectScratch.depthAt(x, y) = depth;
+
+                        const bool miss = std::isinf(depth);
+                        glm::vec3 hitPos = passCam.position + dir * depth;
+                        glm::vec2 uv;
+                        if (!oldCam.directionToUV(miss ? dir : hitPos - oldCam.position, uv)) {
+                            continue;
+                        }
+                        long ox = std::lround(uv.x * width);
+                        long oy = std::lround(uv.y * height);
+                        if (ox < 0 || oy < 0 || ox >= long(width) || oy >= long(height)) {
+                            continue;
+                        }
+                        uint32_t count = traceImageData.samplesAt(ox, oy);
+                        float oldDepth = traceImageData.depthAt(ox, oy);
+                        if (count == 0 || std::isnan(oldDepth)) {
+                            continue;
+                        }
+                        bool match = miss ? std::isinf(oldDepth)
+                                          : std::abs(glm::length(hitPos - oldCam.position) - oldDepth) <=
+                                                tolerance * std::max(oldDepth, 1e-3f);
+                        if (!match) {
+                            continue;
+                        }
+                        uint32_t kept = std::max(1u, static_cast<uint32_t>(count * weight));
+                        reprojectScratch.copyPixel(x, y, traceImageData, ox, oy, kept);
+                        ++localAccepted;
+                    }
                 }
+                accepted.fetch_add(localAccepted, std::memory_order_relaxed);
+            });
+        }
+        group.wait();
+    }
+    std::swap(traceImageData, reprojectScratch);
+    SamplingSettings::reprojectedRatio = static_cast<float>(accepted.load()) / static_cast<float>(std::max<size_t>(width * height, 1));
+}
+
+void TraceCPUBase::cancel() {
+    cancellation.cancel();
+}
+
+void TraceCPUBase::present(Texture2D &traceOutput) {
+    if (traceImageData.width != traceOutput.Width || traceImageData.height != traceOutput.Height) {
+        return; // 本遍开始后窗口尺寸已改变
+    }
+    if (passPreviewScale > 1) {
+        // 最近邻放大到全分辨率
+        const size_t width = traceImageData.width;
+        presentPixels.resize(width * traceImageData.height);
+        for (size_t y = 0; y < traceImageData.height; ++y) {
+            for (size_t x = 0; x < width; ++x) {
+                presentPixels[y * width + x] = previewImageData.pixelAt(x / passPreviewScale, y / passPreviewScale);
             }
-        }));
+        }
+        traceOutput.setData(presentPixels.data());
+        return;
+    }
+    if (!SamplingSettings::showConvergence) {
+        traceOutput.setData(traceImageData.data());
+        return;
     }
-    if (!shadingFutures.empty()) {
-        for (auto &future : shadingFutures) {
-            future.get();
+    // 收敛叠加: 已收敛的块偏绿, 未收敛的块按误差偏红
+    const size_t pixelCount = traceImageData.width * traceImageData.height;
+    presentPixels.assign(traceImageData.data(), traceImageData.data() + pixelCount);
+    for (const auto &tile : passTiles) {
+        if (tile.index >= tileErrors.size()) {
+            continue;
+        }
+        float error = tileErrors[tile.index];
+        glm::vec4 tint = (error < SamplingSettings::errorThreshold)
+                             ? glm::vec4(0.0f, 1.0f, 0.0f, 1.0f)
+                             : glm::vec4(1.0f, 0.0f, 0.0f, 1.0f);
+        float strength = (error < SamplingSettings::errorThreshold)
+                             ? 0.3f
+                             : 0.15f + 0.35f * std::min(error / (10.0f * SamplingSettings::errorThreshold), 1.0f);
+        for (size_t y = tile.y0; y < tile.y1; ++y) {
+            for (size_t x = tile.x0; x < tile.x1; ++x) {
+                auto &pixel = presentPixels[y * traceImageData.width + x];
+                pixel = glm::mix(pixel, tint, strength);
+            }
         }
-        this->shadingFutures.clear();
     }
-    traceOutput.setData(traceImageData.data());
+    traceOutput.setData(presentPixels.data());
 }
 
-// TraceSceneCPU
-TraceSceneCPU::TraceSceneCPU(SceneCPUContext &context) : DIContext(context) {}
-void TraceSceneCPU::trace(const Texture2D &traceInput, Texture2D &traceOutput, int sampleCount) {
-    traceImageData.resize(traceInput.Width, traceInput.Height);
-    auto shade = [this, sampleCount](CPUImageData &imageData, size_t x, size_t y) {
-        const float perturbStrength = 0.001f;
-        auto &pixelColor = imageData.pixelAt(x, y);
-        auto uv = imageData.uvAt(x, y);
-        Ray ray(
-            DIContext.cam.position,
-            DIContext.cam.getRayDirction(uv) + Random::RandomVector(perturbStrength));
-        if (!DIContext.sceneRendering) {
-            throw std::runtime_error("Scene is not loaded.");
+void TraceCPUBase::trace(const Texture2D &traceInput, Texture2D &traceOutput, int sampleCount) {
+    if (prepare(traceInput, sampleCount, 1) > 0) {
+        execute();
+        present(traceOutput);
+    }
+}
+
+// TraceSdSceneCPU
+TraceSdSceneCPU::TraceSdSceneCPU(SdSceneCPUContext &context) : TraceCPUBase(context.cam), DIContext(context) {}
+
+bool TraceSdSceneCPU::pinScene() {
+    passScene = DIContext.sceneRendering->pin(); // 每遍固定一个快照, 着色期间无锁
+    return passScene != nullptr;
+}
+
+void TraceSdSceneCPU::shadeTile(const Tile &tile) {
+    const sd::DataStorage &dataStorage = passScene->storageForNode(Arena::CurrentNumaNode()); // 节点本地副本
+    Trace::PathOptions tileOptions;
+    tileOptions.settings = passSettings.path;
+    tileOptions.radianceCache = passSettings.radianceCache ? &radianceCache : nullptr;
+    tileOptions.guiding = passSettings.pathGuiding ? &guidingField : nullptr;
+    if (passRestir && tileSamples[tile.index] <= 0) {
+        restirHistory.clearTile(tile); // 本遍不着色的像素不保留旧相机下的着色点
+    }
+    shadeTilePixels(tile, [&](const Ray &ray, size_t x, size_t y, int sample) {
+        Trace::PathOptions options = tileOptions;
+        glm::vec3 direct;
+        if (passRestir && sample == 0 && restirDirect(dataStorage, x, y, direct)) {
+            options.primaryDirect = &direct;
         }
-        std::shared_lock<std::shared_mutex> sceneLock(*DIContext.sceneRenderingMutex);
-        auto newColor = Trace::CastRay(ray, 0, *DIContext.sceneRendering);
-        pixelColor = (pixelColor * static_cast<float>(sampleCount - 1.f) + newColor) / static_cast<float>(sampleCount);
-    };
-    size_t rowsPerThread = traceImageData.height / numThreads;
-    for (int i = 0; i < numThreads; ++i) {
-        size_t startY = i * rowsPerThread;
-        size_t endY = (i == numThreads - 1) ? traceImageData.height : startY + rowsPerThread;
-        this->shadingFutures.push_back(std::async(std::launch::async, [this, startY, endY, shade]() {
-            for (size_t y = startY; y < endY; ++y) {
-                for (size_t x = 0; x < traceImageData.width; ++x) {
-                    shade(this->traceImageData, x, y);
-                }
+        return Trace::CastRay(ray, 0, dataStorage, options);
+    });
+}
+
+int TraceSdSceneCPU::prepare(const Texture2D &traceInput, int sampleCount, int previewScale) {
+    if (cancellation.isCancelled()) {
+        restirHasHistory = false; // 上一遍被取消, 部分像素没有写回蓄水池
+    }
+    int samples = TraceCPUBase::prepare(traceInput, sampleCount, previewScale);
+    passRestir = false; // 预览遍不调用 beforeShading
+    if (passScene && passSettings.radianceCache) {
+        resolveRadianceCache(); // 上一遍的 execute 已结束, 此时没有并发访问
+    }
+    if (passScene && passSettings.pathGuiding) {
+        updateGuiding();
+    } else {
+        guidingScene = nullptr; // 重新启用时从头训练
+    }
+    return samples;
+}
+
+// 训练与渲染交替进行: 每遍 execute 用当前分布采样并记录, 遍间在这里结束一遍, 本轮结束时在线程池上重建
+void TraceSdSceneCPU::updateGuiding() {
+    const uint64_t sky = EnvironmentMap::Generation();
+    if (guidingScene != passScene.get() || guidingSky != sky) {
+        const auto &dataStorage = passScene->storageForNode(Arena::CurrentNumaNode());
+        if (dataStorage.rootIndex == sd::invalidIndex) {
+            guidingField.reset(vec3(0.0f), vec3(0.0f)); // 空场景
+        } else {
+            const auto &bounds = dataStorage.nodeStorage.nodes[dataStorage.rootIndex].box;
+            guidingField.reset(bounds.pMin, bounds.pMax);
+        }
+        guidingScene = passScene.get();
+        guidingSky = sky;
+    } else {
+        guidingField.endPass();
+    }
+    SamplingSettings::guidingIteration = guidingField.currentIteration();
+    SamplingSettings::guidingLeaves = static_cast<int>(guidingField.leafCount());
+}
+
+void TraceSdSceneCPU::resolveRadianceCache() {
+    const uint64_t sky = EnvironmentMap::Generation();
+    if (radianceCacheScene != passScene.get() || radianceCacheSky != sky ||
+        radianceCache.cellSize != SamplingSettings::radianceCacheCellSize) {
+        radianceCache.clear();
+        radianceCache.cellSize = std::max(SamplingSettings::radianceCacheCellSize, 1e-3f);
+        SamplingSettings::radianceCacheCellSize = radianceCache.cellSize;
+        radianceCacheScene = passScene.get();
+        radianceCacheSky = sky;
+    } else {
+        radianceCache.resolve();
+    }
+    SamplingSettings::radianceCacheEntries = static_cast<int>(radianceCache.size());
+}
+
+// 只有天空已建好时启用: 主光线命中点之后的天空贡献全部交给蓄水池, 渐变天空无法采样
+void TraceSdSceneCPU::beforeShading() {
+    passRestir = passSettings.restir && EnvironmentMap::Current() != nullptr;
+    if (!passRestir) {
+        restirHasHistory = false;
+        return;
+    }
+    const size_t width = traceImageData.width;
+    const size_t height = traceImageData.height;
+    if (restirCurrent.width != width || restirCurrent.height != height || restirScene != pinnedScene()) {
+        restirCurrent.resize(width, height);
+        restirHistory.resize(width, height);
+        restirHistory.clear();
+        restirHasHistory = false; // 历史中的三角形序号只在同一场景快照内有效
+    }
+    tileScheduler.run(ThreadPool::Global(), passTiles, [this](const Tile &tile) {
+        generateReservoirs(tile);
+    }, &cancellation);
+    // 着色时把本遍的蓄水池写回 restirHistory
+    restirCam = passCam;
+    restirScene = pinnedScene();
+    restirHasHistory = true;
+}
+
+// 与本遍第一个采样相同的主光线求命中点, 生成候选并并入上一遍重投影位置的蓄水池
+void TraceSdSceneCPU::generateReservoirs(const Tile &tile) {
+    if (tileSamples[tile.index] <= 0) {
+        return; // 已收敛, 本遍不着色
+    }
+    const sd::DataStorage &dataStorage = passScene->storageForNode(Arena::CurrentNumaNode());
+    const EnvironmentMap *environment = EnvironmentMap::Current();
+    const size_t width = traceImageData.width;
+    const size_t height = traceImageData.height;
+    const bool temporal = passSettings.restirTemporal && restirHasHistory;
+    const int candidates = passSettings.restirCandidates;
+    const float historyLimit = static_cast<float>(passSettings.restirHistoryLimit * candidates);
+    for (size_t y = tile.y0; y < tile.y1; ++y) {
+        for (size_t x = tile.x0; x < tile.x1; ++x) {
+            Random::SeedSample(static_cast<uint32_t>(x), static_cast<uint32_t>(y), traceImageData.samplesAt(x, y), sampleEpoch, passSettings.sampler, passSettings.blueNoise);
+            Ray ray = generateRay(x, y);
+            Restir::Surface &surface = restirCurrent.surfaceAt(x, y);
+            Restir::Reservoir &reservoir = restirCurrent.reservoirAt(x, y);
+            surface = Restir::MakeSurface(dataStorage, ray, sd::BVH::IntersectLoop(dataStorage, ray));
+            reservoir = Restir::Reservoir();
+            if (!surface.valid) {
+                continue;
+            }
+            Random::PCG32 rng(y * width + x, passIndex * 2);
+            reservoir = Restir::SampleCandidates(dataStorage, environment, surface, candidates, rng);
+            glm::vec2 uv;
+            if (!temporal || !restirCam.directionToUV(surface.pos - restirCam.position, uv)) {
+                continue;
+            }
+            long px = static_cast<long>(std::floor(uv.x * width)); // 采样覆盖 [x, x+1) / width
+            long py = static_cast<long>(std::floor(uv.y * height));
+            if (px < 0 || py < 0 || px >= long(width) || py >= long(height) ||
+                !Restir::Similar(surface, restirHistory.surfaceAt(px, py))) {
+                continue;
             }
-        }));
+            Restir::Reservoir history = restirHistory.reservoirAt(px, py);
+            history.M = std::min(history.M, historyLimit); // 限制历史的权重, 光照变化后能较快更新
+            reservoir.merge(history, Restir::TargetPdf(dataStorage, environment, surface, history.sample), rng.nextFloat());
+            reservoir.finalize();
+        }
     }
-    if (!shadingFutures.empty()) {
-        for (auto &future : shadingFutures) {
-            future.get();
+}
+
+// 空域复用邻域像素的蓄水池, 对最终选中的样本做一次可见性测试; 像素没有可用的着色点时返回 false
+bool TraceSdSceneCPU::restirDirect(const sd::DataStorage &dataStorage, size_t x, size_t y, glm::vec3 &direct) {
+    const Restir::Surface &surface = restirCurrent.surfaceAt(x, y);
+    if (!surface.valid) {
+        // 天空, 光源或镜面: 也写回历史, 下一遍不会与旧相机下的着色点匹配
+        restirHistory.reservoirAt(x, y) = Restir::Reservoir();
+        restirHistory.surfaceAt(x, y) = surface;
+        return false;
+    }
+    const EnvironmentMap *environment = EnvironmentMap::Current();
+    Restir::Reservoir reservoir = restirCurrent.reservoirAt(x, y);
+    Random::PCG32 rng(y * restirCurrent.width + x, passIndex * 2 + 1);
+    const float radius = passSettings.restirSpatialRadius;
+    for (int i = 0; i < passSettings.restirSpatialNeighbors; ++i) {
+        float r = radius * std::sqrt(rng.nextFloat());
+        float phi = glm::two_pi<float>() * rng.nextFloat();
+        long nx = std::lround(static_cast<float>(x) + r * std::cos(phi));
+        long ny = std::lround(static_cast<float>(y) + r * std::sin(phi));
+        if (nx < 0 || ny < 0 || nx >= long(restirCurrent.width) || ny >= long(restirCurrent.height) ||
+            (size_t(nx) == x && size_t(ny) == y) || !Restir::Similar(surface, restirCurrent.surfaceAt(nx, ny))) {
+            continue;
         }
-        this->shadingFutures.clear();
+        const Restir::Reservoir &neighbor = restirCurrent.reservoirAt(nx, ny);
+        reservoir.merge(neighbor, Restir::TargetPdf(dataStorage, environment, surface, neighbor.sample), rng.nextFloat());
     }
-    traceOutput.setData(traceImageData.data());
+    reservoir.finalize();
+    direct = Restir::Shade(dataStorage, environment, surface, reservoir);
+    restirHistory.reservoirAt(x, y) = reservoir;
+    restirHistory.surfaceAt(x, y) = surface;
+    return true;
+}
+
+float TraceSdSceneCPU::primaryHitDistance(const Ray &ray) {
+    return sd::BVH::IntersectLoop(passScene->storageForNode(Arena::CurrentNumaNode()), ray).t;
+}
+
+// TraceSceneCPU
+TraceSceneCPU::TraceSceneCPU(SceneCPUContext &context) : TraceCPUBase(context.cam), DIContext(context) {}
+
+bool TraceSceneCPU::pinScene() {
+    passScene = DIContext.sceneRendering->pin(); // 每遍固定一个快照, 着色期间无锁
+    return passScene != nullptr;
+}
+
+void TraceSceneCPU::shadeTile(const Tile &tile) {
+    const Scene &scene = *passScene;
+    shadeTilePixels(tile, [&scene](const Ray &ray, size_t, size_t, int) { return Trace::CastRay(ray, 0, scene); });
+}
+
+float TraceSceneCPU::primaryHitDistance(const Ray &ray) {
+    return BVHSettings::toggleBVHAccel ? passScene->intersectClosestBVH(ray).t : passScene->intersectClosest(ray).t;
 }
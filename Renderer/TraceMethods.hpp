@@ -7,54 +7,342 @@
 #include "Random.hpp"
 #include "UI.hpp"
 #include "Trace.hpp"
+#include "MemoryRegistry.hpp"
+#include "TileScheduler.hpp"
+#include "Restir.hpp"
+#include "RadianceCache.hpp"
+#include "PathGuiding.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
 
-#include <future>
 class TraceSdSceneGPU : public ITraceMethod // 产生对应Context的引用依赖
 {
     SdSceneGPUContext &DIContext; // DI 必须
     RenderTarget traceRenderTarget;
     Shader traceShader;
+    Texture2D blueNoiseTex; // RG 两通道蓝噪声遮罩, 环绕平铺
 public:
     TraceSdSceneGPU(SdSceneGPUContext &context);
     void trace(const Texture2D &traceInput, Texture2D &traceOutput, int sampleCount) override;
 };
 
+// CPU累计图像
+// 每个像素保存颜色均值, 亮度平方的均值与采样数, 由此估计均值的相对标准误差, 用于自适应采样
+// 另存主光线首次命中的距离(未命中为无穷大, 尚未计算为NaN), 用于相机移动时重投影
 class CPUImageData
 {
     std::vector<glm::vec4> pixels; // RGBA format
+    std::vector<float> lumaSquares; // 亮度平方的均值
+    std::vector<uint32_t> sampleCounts;
+    std::vector<float> depths;
+    MemoryRegistry::Tracker memoryTracker{MemoryRegistry::Category::CPUImage};
 public:
     size_t width;
     size_t height;
+    inline static float Luminance(const glm::vec4 &color) { return 0.2126f * color.r + 0.7152f * color.g + 0.0722f * color.b; }
+
     inline void setPixel(size_t x, size_t y, glm::vec4 &value) { this->pixels[y * width + x] = value; }
     inline glm::vec4 &pixelAt(size_t x, size_t y) { return pixels[y * width + x]; }
     inline glm::vec2 uvAt(size_t x, size_t y) { return glm::vec2(x / float(width), y / float(height)); }
+    inline uint32_t samplesAt(size_t x, size_t y) const { return sampleCounts[y * width + x]; }
+    inline float &depthAt(size_t x, size_t y) { return depths[y * width + x]; }
+
+    // 从另一幅图像复制一个像素的统计, 采样数替换为 count
+    inline void copyPixel(size_t x, size_t y, const CPUImageData &source, size_t sx, size_t sy, uint32_t count)
+    {
+        size_t i = y * width + x;
+        size_t j = sy * source.width + sx;
+        pixels[i] = source.pixels[j];
+        lumaSquares[i] = source.lumaSquares[j];
+        sampleCounts[i] = count;
+    }
+
+    // 并入 count 个新采样: colorSum 为颜色之和, lumaSquareSum 为亮度平方之和
+    inline void addSamples(size_t x, size_t y, const glm::vec4 &colorSum, float lumaSquareSum, uint32_t count)
+    {
+        size_t i = y * width + x;
+        float previous = static_cast<float>(sampleCounts[i]);
+        float total = previous + static_cast<float>(count);
+        pixels[i] = (pixels[i] * previous + colorSum) / total;
+        lumaSquares[i] = (lumaSquares[i] * previous + lumaSquareSum) / total;
+        sampleCounts[i] += count;
+    }
+
+    // 均值的相对标准误差 sqrt(Var/n) / mean
+    inline float relativeError(size_t x, size_t y) const
+    {
+        size_t i = y * width + x;
+        if (sampleCounts[i] < 2)
+        {
+            return std::numeric_limits<float>::infinity();
+        }
+        float mean = Luminance(pixels[i]);
+        float variance = std::max(lumaSquares[i] - mean * mean, 0.0f);
+        return std::sqrt(variance / static_cast<float>(sampleCounts[i])) / (mean + 1e-3f);
+    }
+
+    inline void clearStatistics()
+    {
+        std::fill(lumaSquares.begin(), lumaSquares.end(), 0.0f);
+        std::fill(sampleCounts.begin(), sampleCounts.end(), 0u);
+        std::fill(depths.begin(), depths.end(), std::numeric_limits<float>::quiet_NaN());
+    }
+
     inline void resize(size_t w, size_t h)
     {
         width = w;
         height = h;
         pixels.resize(w * h, glm::vec4(0.0f));
+        lumaSquares.resize(w * h, 0.0f);
+        sampleCounts.resize(w * h, 0u);
+        depths.resize(w * h, std::numeric_limits<float>::quiet_NaN());
+        memoryTracker.set(
+            pixels.capacity() * sizeof(glm::vec4) + (lumaSquares.capacity() + depths.capacity()) * sizeof(float) + sampleCounts.capacity() * sizeof(uint32_t),
+            pixels.size() * sizeof(glm::vec4) + (lumaSquares.size() + depths.size()) * sizeof(float) + sampleCounts.size() * sizeof(uint32_t));
     }
     inline glm::vec4 *data() { return pixels.data(); }
 };
 
-class TraceSdSceneCPU : public ITraceMethod
+// 每像素的 ReSTIR 蓄水池与其所属的主光线着色点, 与累计图像同尺寸
+class ReservoirBuffer
 {
-    SdSceneCPUContext &DIContext;
+    std::vector<Restir::Reservoir> reservoirs;
+    std::vector<Restir::Surface> surfaces;
+    MemoryRegistry::Tracker memoryTracker{MemoryRegistry::Category::CPUImage};
+public:
+    size_t width = 0;
+    size_t height = 0;
+
+    inline Restir::Reservoir &reservoirAt(size_t x, size_t y) { return reservoirs[y * width + x]; }
+    inline const Restir::Reservoir &reservoirAt(size_t x, size_t y) const { return reservoirs[y * width + x]; }
+    inline Restir::Surface &surfaceAt(size_t x, size_t y) { return surfaces[y * width + x]; }
+    inline const Restir::Surface &surfaceAt(size_t x, size_t y) const { return surfaces[y * width + x]; }
+
+    inline void clear()
+    {
+        std::fill(reservoirs.begin(), reservoirs.end(), Restir::Reservoir());
+        std::fill(surfaces.begin(), surfaces.end(), Restir::Surface());
+    }
+    inline void clearTile(const Tile &tile)
+    {
+        for (size_t y = tile.y0; y < tile.y1; ++y)
+        {
+            std::fill(reservoirs.begin() + y * width + tile.x0, reservoirs.begin() + y * width + tile.x1, Restir::Reservoir());
+            std::fill(surfaces.begin() + y * width + tile.x0, surfaces.begin() + y * width + tile.x1, Restir::Surface());
+        }
+    }
+
+    inline void resize(size_t w, size_t h)
+    {
+        width = w;
+        height = h;
+        reservoirs.resize(w * h);
+        surfaces.resize(w * h);
+        memoryTracker.set(
+            reservoirs.capacity() * sizeof(Restir::Reservoir) + surfaces.capacity() * sizeof(Restir::Surface),
+            reservoirs.size() * sizeof(Restir::Reservoir) + surfaces.size() * sizeof(Restir::Surface));
+    }
+};
+
+// 后台着色读取的设置, 与相机一样在 prepare(主线程)中拷贝; UI 在一遍进行中的修改在下一遍生效
+struct PassSettings
+{
+    Random::SamplerType sampler = Random::SamplerType::Sobol;
+    bool blueNoise = true;
+    uint32_t minSamples = 16;
+    float historyWeight = 0.5f;
+    float depthTolerance = 0.02f;
+    Trace::PathSettings path;
+    // 以下只用于 sd 场景
+    bool radianceCache = false;
+    bool pathGuiding = false;
+    bool restir = false;
+    bool restirTemporal = true;
+    int restirCandidates = 16;
+    int restirHistoryLimit = 20;
+    int restirSpatialNeighbors = 3;
+    float restirSpatialRadius = 16.f;
+
+    static PassSettings Capture();
+};
+
+// CPU 追踪方法的公共部分: 累计图像, 分块调度, 以及每遍开始时固定的相机, 设置与采样数
+// 相机在 prepare 时拷贝, 一遍进行中UI修改相机不会影响本遍, 在下一遍生效
+class TraceCPUBase : public IAsyncTraceMethod
+{
+protected:
+    Camera &cam;
+    Camera passCam;
+    PassSettings passSettings;
+    int passSamplesPerPixel = 1;     // 本遍的基准每像素采样数, 自适应时按块误差缩放
+    double passTotalSamples = 0.0;   // 本遍计划的总采样数
+    double sampleCostEstimate = 0.0; // 每像素每采样耗时(毫秒)的滑动估计, 0 表示尚无估计
+
+    // 自适应采样的按块状态, 以 Tile::index 索引
+    // tileErrors 由着色线程在块结束时写入, tileSamples 在 prepare 中决定; 同一遍内两者不会被并发读写同一元素
+    std::vector<float> tileErrors;
+    std::vector<int> tileSamples; // 本遍该块的每像素采样数, 0 表示已收敛
+    uint64_t tileGeneration = 0;
+    // 本遍的块列表, 在 prepare 中拷贝; 后台着色时 UI 修改块设置或线程数只会在下一遍生效, 不会与上面两个数组错位
+    std::vector<Tile> passTiles;
+    std::vector<glm::vec4> presentPixels; // 上传前的合成结果(预览放大, 收敛叠加)
     CPUImageData traceImageData;
-    size_t numThreads = 16;
-    std::vector<std::future<void>> shadingFutures;
+    TileScheduler tileScheduler;
+
+    // 随机数种子: 每个采样由 (像素, 采样序号, sampleEpoch) 决定, 重置采样时换一个 epoch 避免与历史采样相关
+    uint64_t passIndex = 0;
+    uint64_t sampleEpoch = 0;
+
+    // 交互预览: 低分辨率图像与独立的块列表, 不影响累计图像与自适应状态
+    int passPreviewScale = 1;
+    CPUImageData previewImageData;
+    TileScheduler previewScheduler;
+    std::vector<Tile> previewTiles; // 与 passTiles 一样在 prepare 中拷贝
+
+    // 时域重投影: 累计图像所对应的相机与场景, 相机改变后把历史重投影到新视角而不是丢弃
+    bool hasHistory = false;
+    bool passReproject = false;
+    Camera historyCam;
+    Camera reprojectCam; // 本遍重投影的来源相机
+    const void *historyScene = nullptr;
+    CPUImageData reprojectScratch;
+    CancellationToken cancellation;
+
+    /// 固定本遍使用的场景快照, 场景尚未上传时返回 false
+    virtual bool pinScene() = 0;
+    /// 着色一块, 可被多个工作线程并发调用
+    virtual void shadeTile(const Tile &tile) = 0;
+    /// 本遍场景快照的标识, 用于判断历史累计是否来自同一场景
+    virtual const void *pinnedScene() const = 0;
+    /// 主光线首次命中的距离, 未命中返回无穷大; 可并发调用
+    virtual float primaryHitDistance(const Ray &ray) = 0;
+    /// 全分辨率遍着色之前的全图预处理, 在重投影之后调用
+    virtual void beforeShading() {}
+    void reprojectHistory();
+
+    inline Ray generateRay(const glm::vec2 &uv)
+    {
+        return Ray(passCam.position, passCam.getRayDirction(uv));
+    }
+    // 像素内抖动取自采样器的相机维度组
+    inline Ray generateRay(size_t x, size_t y)
+    {
+        glm::vec2 jitter = Random::Sample2D();
+        return generateRay(glm::vec2((x + jitter.x) / traceImageData.width, (y + jitter.y) / traceImageData.height));
+    }
+    // 对块内每个像素采样 tileSamples 次, 与已有结果按采样数加权平均, 最后更新块误差
+    // 预览遍中块坐标属于低分辨率图像, 每个像素取对应全分辨率像素块中心的一个采样
+    // castRay(ray, x, y, sample): sample 为本遍内该像素的采样序号, 预览遍为 -1
+    template <typename CastRayFn>
+    inline void shadeTilePixels(const Tile &tile, CastRayFn &&castRay)
+    {
+        if (passPreviewScale > 1)
+        {
+            const float scale = static_cast<float>(passPreviewScale);
+            for (size_t y = tile.y0; y < tile.y1; ++y)
+            {
+                for (size_t x = tile.x0; x < tile.x1; ++x)
+                {
+                    glm::vec2 uv((x + 0.5f) * scale / traceImageData.width, (y + 0.5f) * scale / traceImageData.height);
+                    Random::SeedSample(static_cast<uint32_t>(x), static_cast<uint32_t>(y), 0, passIndex, passSettings.sampler, passSettings.blueNoise);
+                    previewImageData.pixelAt(x, y) = castRay(generateRay(uv), x, y, -1);
+                }
+            }
+            return;
+        }
+        const int samples = tileSamples[tile.index];
+        if (samples <= 0)
+        {
+            return; // 已收敛
+        }
+        for (size_t y = tile.y0; y < tile.y1; ++y)
+        {
+            for (size_t x = tile.x0; x < tile.x1; ++x)
+            {
+                glm::vec4 sum(0.0f);
+                float lumaSquareSum = 0.0f;
+                const uint64_t firstSample = traceImageData.samplesAt(x, y);
+                for (int s = 0; s < samples; ++s)
+                {
+                    Random::SeedSample(static_cast<uint32_t>(x), static_cast<uint32_t>(y), firstSample + s, sampleEpoch, passSettings.sampler, passSettings.blueNoise);
+                    glm::vec4 color = castRay(generateRay(x, y), x, y, s);
+                    float luma = CPUImageData::Luminance(color);
+                    sum += color;
+                    lumaSquareSum += luma * luma;
+                }
+                traceImageData.addSamples(x, y, sum, lumaSquareSum, static_cast<uint32_t>(samples));
+                float &depth = traceImageData.depthAt(x, y);
+                if (std::isnan(depth))
+                {
+                    depth = primaryHitDistance(Ray(passCam.position, passCam.getRayDirction(traceImageData.uvAt(x, y))));
+                }
+            }
+        }
+        tileErrors[tile.index] = measureTileError(tile);
+    }
+    float measureTileError(const Tile &tile) const;
+    int chooseSamplesPerPixel(size_t activePixels) const;
+    size_t planAdaptiveSamples(const std::vector<Tile> &tiles);
+
 public:
-    TraceSdSceneCPU(SdSceneCPUContext &context);
+    TraceCPUBase(Camera &_cam) : cam(_cam) {}
+    int prepare(const Texture2D &traceInput, int sampleCount, int previewScale) override;
+    void execute() override;
+    void present(Texture2D &traceOutput) override;
+    void cancel() override;
     void trace(const Texture2D &traceInput, Texture2D &traceOutput, int sampleCount) override;
 };
 
-class TraceSceneCPU : public ITraceMethod
+class TraceSdSceneCPU : public TraceCPUBase
+{
+    SdSceneCPUContext &DIContext;
+    std::shared_ptr<const sd::Scene> passScene;
+
+    // ReSTIR 直接光照: 着色前生成每像素的初始蓄水池并做时域复用, 着色时再做空域复用与可见性测试
+    // restirCurrent 在着色时只读, 作为空域复用的邻域; 最终的蓄水池写回 restirHistory 供下一遍时域复用
+    bool passRestir = false;
+    ReservoirBuffer restirCurrent;
+    ReservoirBuffer restirHistory;
+    bool restirHasHistory = false;
+    Camera restirCam; // restirHistory 所对应的相机
+    const void *restirScene = nullptr;
+    void generateReservoirs(const Tile &tile);
+    bool restirDirect(const sd::DataStorage &dataStorage, size_t x, size_t y, vec3 &direct);
+
+    // 世界空间辐射缓存, 跨遍保留; 场景快照, 天空或单元大小改变时清空
+    RadianceCache radianceCache;
+    const void *radianceCacheScene = nullptr;
+    uint64_t radianceCacheSky = 0;
+    void resolveRadianceCache();
+
+    // 路径引导的 SD 树, 跨遍训练; 场景快照或天空改变时以新的场景包围盒重新训练
+    PathGuiding::SDTree guidingField;
+    const void *guidingScene = nullptr;
+    uint64_t guidingSky = 0;
+    void updateGuiding();
+protected:
+    bool pinScene() override;
+    void shadeTile(const Tile &tile) override;
+    const void *pinnedScene() const override { return passScene.get(); }
+    float primaryHitDistance(const Ray &ray) override;
+    void beforeShading() override;
+public:
+    TraceSdSceneCPU(SdSceneCPUContext &context);
+    int prepare(const Texture2D &traceInput, int sampleCount, int previewScale) override;
+};
+
+class TraceSceneCPU : public TraceCPUBase
 {
     SceneCPUContext &DIContext;
-    CPUImageData traceImageData;
-    size_t numThreads = 16;
-    std::vector<std::future<void>> shadingFutures;
+    std::shared_ptr<const Scene> passScene;
+protected:
+    bool pinScene() override;
+    void shadeTile(const Tile &tile) override;
+    const void *pinnedScene() const override { return passScene.get(); }
+    float primaryHitDistance(const Ray &ray) override;
 public:
     TraceSceneCPU(SceneCPUContext &context);
-    void trace(const Texture2D &traceInput, Texture2D &traceOutput, int sampleCount) override;
 };
\ No newline at end of file
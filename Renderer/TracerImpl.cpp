@@ -1,4 +1,10 @@
 #include "TracerImpl.hpp"
+#include "ThreadPool.hpp"
+#include "Shader.hpp"
+#include "UI.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
 #include <utility>
 
 TracerAsync::TracerAsync(int width, int height) {
@@ -6,9 +12,58 @@ TracerAsync::TracerAsync(int width, int height) {
     traceOutput.generate(width, height, GL_RGBA32F, GL_RGBA, GL_FLOAT, NULL);
 }
 
+TracerAsync::~TracerAsync() {
+    waitForCompletion();
+}
+
+void TracerAsync::finishPendingPass(bool presentResult) {
+    try {
+        pendingPass.get();
+        if (presentResult && !discardPending) {
+            pendingMethod->present(traceOutput);
+        }
+    } catch (std::exception &e) {
+        std::cerr << "CPU trace pass failed: " << e.what() << std::endl;
+    }
+    pendingMethod = nullptr;
+    discardPending = false;
+}
+
 void TracerAsync::render(ITraceMethod &method) {
-    std::swap(traceInput, traceOutput);
-    method.trace(traceInput, traceOutput, currentSampleCount++);
+    ++framesSinceReset;
+    auto asyncMethod = dynamic_cast<IAsyncTraceMethod *>(&method);
+    if (!asyncMethod) {
+        waitForCompletion(); // 切换到同步方法前收尾
+        std::swap(traceInput, traceOutput);
+        method.trace(traceInput, traceOutput, currentSampleCount++);
+        return;
+    }
+    if (pendingPass.valid()) {
+        if (discardPending) {
+            pendingPass.wait(); // 已取消, 各线程完成当前块即返回, 等待时间不超过一块
+        }
+        if (pendingPass.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            return; // 上一遍仍在进行, 继续显示已完成的结果
+        }
+        finishPendingPass(pendingMethod == asyncMethod);
+    }
+    // 本遍边界: 此时读取的相机与设置才会生效
+    int scale = previewScale;
+    if (scale <= 2 && framesSinceReset > SamplingSettings::stillFrames) {
+        scale = 1; // 相机已静止, 开始全分辨率累计
+    }
+    int passSamples = asyncMethod->prepare(traceOutput, currentSampleCount, scale);
+    if (passSamples <= 0) {
+        return;
+    }
+    pendingMethod = asyncMethod;
+    pendingPass = ThreadPool::Global().submit([asyncMethod]() { asyncMethod->execute(); });
+    if (scale > 1) {
+        previewScale = std::max(scale / 2, 2); // 预览不计入累计, 下一遍提高分辨率
+    } else {
+        previewScale = 1;
+        currentSampleCount += passSamples;
+    }
 }
 
 TextureID TracerAsync::getTraceOutputTextureID() {
@@ -16,13 +71,22 @@ TextureID TracerAsync::getTraceOutputTextureID() {
 }
 
 void TracerAsync::resetSamples() {
+    if (pendingPass.valid()) {
+        pendingMethod->cancel(); // 相机或场景已改变, 进行中的一遍作废
+        discardPending = true;
+    }
     traceInput.setData(NULL);
     traceOutput.setData(NULL);
     currentSampleCount = 1;
+    framesSinceReset = 0;
+    previewScale = SamplingSettings::progressivePreview ? 8 : 1;
 }
 
 void TracerAsync::waitForCompletion() {
-    // Wait for any asynchronous operations to complete
+    if (pendingPass.valid()) {
+        pendingMethod->cancel();
+        finishPendingPass(false); // 调用方随后可能销毁追踪方法, 不再上传
+    }
 }
 
 void TracerAsync::resize(int newWidth, int newHeight) {
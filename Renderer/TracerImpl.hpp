@@ -1,17 +1,31 @@
 #pragma once
 #include "RenderInterfaces.hpp"
+#include <future>
 
-// WIP
+// 异步 Tracer
+// IAsyncTraceMethod 在线程池上逐遍执行, render 只负责: 上一遍完成则上传结果并开始下一遍, 否则直接返回, 不阻塞UI线程.
+// 其他追踪方法(GPU)仍在调用线程同步执行.
 class TracerAsync : public ITracer
 {
     Texture2D traceInput;
     Texture2D traceOutput;
     int currentSampleCount = 1;
+
+    std::future<void> pendingPass;      // 正在后台执行的一遍
+    IAsyncTraceMethod *pendingMethod = nullptr;
+    bool discardPending = false;        // 重置采样后, 进行中的一遍结果作废
+
+    // 交互预览: 重置后依次以 1/8, 1/4, 1/2 分辨率预览, 相机静止足够帧数后才开始全分辨率累计
+    int framesSinceReset = 0;
+    int previewScale = 1; // 下一遍的预览缩放, 1 表示全分辨率
+
+    void finishPendingPass(bool presentResult);
 public:
     TracerAsync(int width, int height);
+    ~TracerAsync() override;
     void render(ITraceMethod &method) override;
     TextureID getTraceOutputTextureID() override;
     void resetSamples() override;
     void waitForCompletion() override;
     void resize(int newWidth, int newHeight) override;
-};
\ No newline at end of file
+};
@@ -14,6 +14,9 @@
 #include "ModelLoader.hpp"
 #include "Storage.hpp"
 #include "UI.hpp"
+#include "MemoryUI.hpp"
+#include "TileScheduler.hpp"
+#include "Benchmark.hpp"
 #include "Renderer.hpp"
 
 const int InitWidth = 640;
@@ -119,6 +122,15 @@ int main()
                     Storage::OldScene.update();
                 }
             }
+            if (ImGui::Button("Add Area Light"))
+            {
+                RenderState::Dirty |= true;
+                RenderState::SceneDirty |= true;
+                {
+                    std::unique_lock<std::shared_mutex> lock(Storage::SdSceneMutex);
+                    Storage::SdScene.addAreaLight(renderer->cam.lookAtCenter + glm::vec3(0.0f, 3.0f, 0.0f), 2.0f, color4(8.0f, 8.0f, 8.0f, 1.0f));
+                }
+            }
             ImGui::End();
         }
         BVHSettings::RenderUI();
@@ -133,6 +145,11 @@ int main()
 
         BVHSettings::RenderVisualization(*Storage::SdScene.pDataStorage);
         SkySettings::RenderUI();
+        SamplingSettings::RenderUI();
+        MemorySettings::RenderUI();
+        MemoryRegistry::RenderUI();
+        TileSettings::RenderUI();
+        Benchmark::RenderUI(renderer->cam);
 
         DebugObjectRenderer::SetCamera(&renderer->cam);
         DebugObjectRenderer::Render();